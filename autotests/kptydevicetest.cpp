@@ -0,0 +1,670 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kptydevicetest.h"
+#include "kptytesthelpers.h"
+
+#include <QElapsedTimer>
+#include <QSignalSpy>
+#include <QTest>
+#include <kptyawaitable.h>
+#include <kptydevice.h>
+#include <kptyprocess.h>
+
+#include <coroutine>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+void KPtyDeviceTest::test_rate_limit()
+{
+    KPtyProcess p;
+    p.setProgram("/bin/sh", QStringList() << "-c" << "head -c 120000 /dev/zero; sleep 5");
+    p.setPtyChannels(KPtyProcess::AllChannels);
+    p.pty()->setReadRateLimit(200000, 20000);
+    QCOMPARE(p.pty()->readRateLimit(), qint64(200000));
+    QCOMPARE(p.pty()->readBurst(), qint64(20000));
+
+    QElapsedTimer timer;
+    timer.start();
+    p.start();
+
+    qint64 received = 0;
+    while (received < 120000) {
+        QVERIFY(p.pty()->waitForReadyRead(5000));
+        received += p.pty()->readAll().size();
+    }
+
+    // 100000 bytes beyond the burst take at least half a second
+    QVERIFY(timer.elapsed() >= 450);
+    const KPtyDevice::Statistics stats = p.pty()->statistics();
+    QCOMPARE(stats.bytesRead, qint64(120000));
+    QVERIFY(stats.throttleCount > 0);
+    QVERIFY(stats.throttledTime > 0);
+    QCOMPARE(stats.readRateLimit, qint64(200000));
+
+    p.pty()->setReadRateLimit(0);
+    QVERIFY(!p.pty()->isThrottled());
+    QVERIFY(!p.pty()->isSuspended());
+
+    p.terminate();
+    p.waitForFinished();
+}
+
+void KPtyDeviceTest::test_urgent_write()
+{
+    KPtyDevice pty;
+    QVERIFY(openRawPty(&pty));
+
+    pty.write("bulk");
+    pty.write("!", KPtyDevice::WriteFlag::Urgent);
+    QCOMPARE(pty.bytesToWrite(), qint64(5));
+    while (pty.bytesToWrite()) {
+        QVERIFY(pty.waitForBytesWritten(1000));
+    }
+
+    // the data reaches the slave asynchronously, possibly in pieces
+    auto readSlave = [&pty](qsizetype size) {
+        QByteArray data;
+        char buf[16];
+        while (data.size() < size) {
+            const ssize_t len = ::read(pty.slaveFd(), buf, sizeof(buf));
+            if (len <= 0) {
+                break;
+            }
+            data.append(buf, len);
+        }
+        return data;
+    };
+    QCOMPARE(readSlave(5), QByteArray("!bulk"));
+
+    pty.write("more bulk");
+    pty.write(QByteArray("\x03"), KPtyDevice::WriteFlag::Urgent | KPtyDevice::WriteFlag::DiscardPending);
+    QCOMPARE(pty.bytesToWrite(), qint64(1));
+    QVERIFY(pty.waitForBytesWritten(1000));
+    QCOMPARE(pty.bytesToWrite(), qint64(0));
+    QCOMPARE(readSlave(1), QByteArray("\x03"));
+}
+
+void KPtyDeviceTest::test_discard_output()
+{
+    KPtyDevice pty;
+    QVERIFY(openRawPty(&pty));
+
+    QCOMPARE(::write(pty.slaveFd(), "stale", 5), ssize_t(5));
+    QVERIFY(pty.waitForReadyRead(1000));
+    QCOMPARE(::write(pty.slaveFd(), "more", 4), ssize_t(4));
+    QVERIFY(pty.bytesAvailable() > 0);
+
+    QVERIFY(pty.discardPendingOutput());
+    QCOMPARE(pty.bytesAvailable(), qint64(0));
+    QVERIFY(!pty.waitForReadyRead(200));
+
+    QCOMPARE(::write(pty.slaveFd(), "fresh", 5), ssize_t(5));
+    QByteArray fresh;
+    while (fresh.size() < 5 && pty.waitForReadyRead(1000)) {
+        fresh += pty.readAll();
+    }
+    QCOMPARE(fresh, QByteArray("fresh"));
+
+    KPtyProcess p;
+    p.setProgram("/bin/sh", QStringList() << "-c" << "sleep 10");
+    p.setPtyChannels(KPtyProcess::AllChannels);
+    p.start();
+    QVERIFY(p.waitForStarted());
+    QTRY_VERIFY(::tcgetpgrp(p.pty()->masterFd()) == p.processId());
+    QVERIFY(p.pty()->discardPendingOutput(SIGTERM));
+    QVERIFY(p.waitForFinished(5000));
+    QCOMPARE(p.exitStatus(), QProcess::CrashExit);
+}
+
+namespace
+{
+// fire-and-forget coroutine type
+struct Task {
+    struct promise_type {
+        Task get_return_object()
+        {
+            return {};
+        }
+        std::suspend_never initial_suspend()
+        {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+        void return_void()
+        {
+        }
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+    };
+};
+
+Task converse(KPtyDevice *pty, QByteArrayList *log, bool *done)
+{
+    pty->write("hello\n");
+    co_await pty->drainAsync();
+    log->append(co_await pty->readLineAsync());
+    pty->write("a::b:c\n");
+    log->append(co_await pty->readUntilAsync(":b:"));
+    log->append(co_await pty->readLineAsync());
+    pty->write("\x04");
+    log->append(co_await pty->readSomeAsync());
+    *done = true;
+}
+
+Task readTwice(KPtyDevice *pty, QByteArrayList *log, bool *done)
+{
+    log->append(co_await pty->readSomeAsync());
+    log->append(co_await pty->readSomeAsync());
+    *done = true;
+}
+
+Task readUntilClosed(KPtyDevice *pty, QByteArray *received, bool *done)
+{
+    while (pty->isOpen()) {
+        received->append(co_await pty->readSomeAsync());
+    }
+    *done = true;
+}
+}
+
+void KPtyDeviceTest::test_awaitable()
+{
+    KPtyProcess p;
+    p.setProgram("/bin/cat");
+    p.setPtyChannels(KPtyProcess::AllChannels);
+    p.pty()->setEcho(false);
+    p.start();
+    QVERIFY(p.waitForStarted());
+    p.pty()->closeSlave();
+
+    QByteArrayList log;
+    bool done = false;
+    converse(p.pty(), &log, &done);
+    QTRY_VERIFY_WITH_TIMEOUT(done, 5000);
+    QCOMPARE(log, QByteArrayList({"hello\r\n", "a::b:", "c\r\n", QByteArray()}));
+
+    p.waitForFinished();
+}
+
+void KPtyDeviceTest::test_awaitable_close()
+{
+    KPtyDevice pty;
+    QVERIFY(openRawPty(&pty));
+
+    // the coroutine sees the device closed when it is resumed
+    QByteArray received;
+    bool done = false;
+    readUntilClosed(&pty, &received, &done);
+    writeSlave(&pty, "data");
+    QTRY_COMPARE_WITH_TIMEOUT(received, QByteArray("data"), 5000);
+    QVERIFY(!done);
+    pty.close();
+    QTRY_VERIFY_WITH_TIMEOUT(done, 5000);
+}
+
+void KPtyDeviceTest::test_awaitable_read_sink()
+{
+    KPtyDevice pty;
+    QVERIFY(openRawPty(&pty));
+    writeSlaveAndWait(&pty, "kept");
+
+    QByteArray sink(8, '\0');
+    pty.setReadSink(
+        [&](qsizetype hint) {
+            Q_UNUSED(hint);
+            return QSpan<char>(sink.data(), sink.size());
+        },
+        [](QSpan<char> data) {
+            Q_UNUSED(data);
+        });
+
+    // no readyRead() would ever end the wait, so it completes right away
+    QByteArrayList log;
+    bool done = false;
+    QTest::ignoreMessage(QtWarningMsg, "Reads can't be awaited while a read sink is set");
+    QTest::ignoreMessage(QtWarningMsg, "Reads can't be awaited while a read sink is set");
+    readTwice(&pty, &log, &done);
+    QVERIFY(done);
+    QCOMPARE(log, QByteArrayList({"kept", QByteArray()}));
+}
+
+void KPtyDeviceTest::test_termios_update()
+{
+    KPtyDevice pty;
+    QVERIFY(pty.open());
+
+    struct ::termios before;
+    QVERIFY(::tcgetattr(pty.slaveFd(), &before) == 0);
+    QVERIFY(before.c_lflag & ECHO);
+    QVERIFY(before.c_lflag & ICANON);
+
+    QVERIFY(pty.beginTermiosUpdate());
+    QVERIFY(pty.isTermiosUpdateActive());
+    QVERIFY(pty.setEcho(false));
+    QVERIFY(pty.beginTermiosUpdate());
+    QVERIFY(pty.setRawMode(true));
+    QVERIFY(pty.setFlowControlEnabled(true));
+    QVERIFY(pty.setWinSize(30, 100));
+    QVERIFY(pty.commitTermiosUpdate());
+    QVERIFY(pty.isTermiosUpdateActive());
+
+    // nothing is applied before the outermost commit
+    struct ::termios ttmode;
+    QVERIFY(pty.tcGetAttr(&ttmode));
+    QVERIFY(!(ttmode.c_lflag & ICANON));
+    QVERIFY(::tcgetattr(pty.slaveFd(), &ttmode) == 0);
+    QVERIFY(ttmode.c_lflag & ICANON);
+
+    QVERIFY(pty.commitTermiosUpdate());
+    QVERIFY(!pty.isTermiosUpdateActive());
+
+    QVERIFY(::tcgetattr(pty.slaveFd(), &ttmode) == 0);
+    QVERIFY(!(ttmode.c_lflag & (ECHO | ICANON | ISIG)));
+    QVERIFY(ttmode.c_iflag & IXON);
+    QVERIFY(ttmode.c_iflag & IXOFF);
+    struct winsize winSize;
+    QVERIFY(::ioctl(pty.slaveFd(), TIOCGWINSZ, &winSize) == 0);
+    QCOMPARE(int(winSize.ws_row), 30);
+    QCOMPARE(int(winSize.ws_col), 100);
+
+    // echo was turned off before raw mode, and stays off
+    QVERIFY(pty.setRawMode(false));
+    QVERIFY(::tcgetattr(pty.slaveFd(), &ttmode) == 0);
+    QVERIFY(ttmode.c_lflag & ICANON);
+    QVERIFY(!(ttmode.c_lflag & ECHO));
+}
+
+void KPtyDeviceTest::test_raw_mode_restore()
+{
+    KPtyDevice pty;
+    QVERIFY(pty.open());
+
+    struct ::termios before;
+    QVERIFY(::tcgetattr(pty.slaveFd(), &before) == 0);
+    before.c_cflag = (before.c_cflag & ~CSIZE) | CS7 | PARENB;
+    before.c_oflag &= ~ONLCR;
+    QVERIFY(::tcsetattr(pty.slaveFd(), TCSANOW, &before) == 0);
+    QVERIFY(::tcgetattr(pty.slaveFd(), &before) == 0);
+
+    QVERIFY(pty.setRawMode(true));
+    struct ::termios ttmode;
+    QVERIFY(::tcgetattr(pty.slaveFd(), &ttmode) == 0);
+    QCOMPARE(ttmode.c_cflag & CSIZE, tcflag_t(CS8));
+    QVERIFY(!(ttmode.c_oflag & OPOST));
+
+    QVERIFY(pty.setRawMode(false));
+    QVERIFY(::tcgetattr(pty.slaveFd(), &ttmode) == 0);
+    QCOMPARE(ttmode.c_iflag, before.c_iflag);
+    QCOMPARE(ttmode.c_oflag, before.c_oflag);
+    QCOMPARE(ttmode.c_lflag, before.c_lflag);
+    QCOMPARE(ttmode.c_cflag, before.c_cflag);
+    QCOMPARE(ttmode.c_cc[VMIN], before.c_cc[VMIN]);
+    QCOMPARE(ttmode.c_cc[VTIME], before.c_cc[VTIME]);
+}
+
+void KPtyDeviceTest::test_winsize_coalescing()
+{
+    KPtyDevice pty;
+    QVERIFY(pty.open());
+    QVERIFY(pty.setWinSize(24, 80));
+    auto rows = [&pty]() {
+        struct winsize winSize;
+        return ::ioctl(pty.slaveFd(), TIOCGWINSZ, &winSize) ? -1 : int(winSize.ws_row);
+    };
+
+    pty.setWinSizeCoalescing(50, 200);
+    QCOMPARE(pty.winSizeQuietPeriod(), 50);
+    QCOMPARE(pty.winSizeMaxDelay(), 200);
+
+    // only the last size of a burst is applied, after the quiet period
+    QVERIFY(pty.requestWinSize(10, 10));
+    QVERIFY(pty.requestWinSize(20, 20));
+    QVERIFY(pty.requestWinSize(30, 40));
+    QVERIFY(pty.hasPendingWinSize());
+    QCOMPARE(rows(), 24);
+    QTRY_VERIFY(!pty.hasPendingWinSize());
+    QCOMPARE(rows(), 30);
+
+    // a continuous stream of requests is applied at the maximal delay
+    QElapsedTimer timer;
+    timer.start();
+    int lines = 31;
+    while (rows() == 30 && timer.elapsed() < 2000) {
+        QVERIFY(pty.requestWinSize(lines++, 40));
+        QTest::qWait(10);
+    }
+    QVERIFY(rows() > 30);
+    QVERIFY(timer.elapsed() < 1000);
+
+    // forcing
+    QVERIFY(pty.requestWinSize(50, 40));
+    QVERIFY(pty.flushWinSize());
+    QVERIFY(!pty.hasPendingWinSize());
+    QCOMPARE(rows(), 50);
+
+    pty.setWinSizeCoalescing(0);
+    QVERIFY(pty.requestWinSize(60, 40));
+    QCOMPARE(rows(), 60);
+}
+
+void KPtyDeviceTest::test_packet_mode()
+{
+#ifndef Q_OS_LINUX
+    QSKIP("The packet mode events are Linux-specific");
+#endif
+    KPtyDevice pty;
+    QVERIFY(pty.open());
+    QVERIFY(pty.setPacketMode(true));
+    QVERIFY(pty.isPacketMode());
+
+    QSignalSpy flowSpy(&pty, &KPtyDevice::flowControlChanged);
+    QVERIFY(pty.setFlowControlEnabled(false));
+    QVERIFY(flowSpy.wait(1000));
+    QCOMPARE(flowSpy.last().at(0).toBool(), false);
+    QVERIFY(pty.setFlowControlEnabled(true));
+    QVERIFY(flowSpy.wait(1000));
+    QCOMPARE(flowSpy.last().at(0).toBool(), true);
+
+    QSignalSpy suspendSpy(&pty, &KPtyDevice::outputSuspended);
+    pty.write("\x13");
+    QVERIFY(suspendSpy.wait(1000));
+    QVERIFY(pty.isOutputSuspended());
+
+    QSignalSpy resumeSpy(&pty, &KPtyDevice::outputResumed);
+    pty.write("\x11");
+    QVERIFY(resumeSpy.wait(1000));
+    QVERIFY(!pty.isOutputSuspended());
+
+    // the status bytes don't end up in the data
+    QCOMPARE(::write(pty.slaveFd(), "hi\n", 3), ssize_t(3));
+    QTRY_COMPARE(pty.bytesAvailable(), qint64(4));
+    QCOMPARE(pty.readAll(), QByteArray("hi\r\n"));
+
+    QSignalSpy eofSpy(&pty, &KPtyDevice::readEof);
+    pty.closeSlave();
+    QVERIFY(eofSpy.wait(1000));
+}
+
+void KPtyDeviceTest::test_termios_tracking()
+{
+    KPtyDevice pty;
+    QVERIFY(pty.open());
+    if (!pty.setTermiosTracking(true)) {
+        QSKIP("Tracking the terminal attributes is not supported");
+    }
+    QVERIFY(pty.isTermiosTracking());
+    QVERIFY(pty.isPacketMode());
+
+    int changes = 0;
+    bool echo = true;
+    connect(&pty, &KPtyDevice::termiosChanged, this, [&](const struct ::termios &ttmode) {
+        changes++;
+        echo = ttmode.c_lflag & ECHO;
+    });
+
+    // like a password prompt
+    struct ::termios ttmode;
+    QVERIFY(::tcgetattr(pty.slaveFd(), &ttmode) == 0);
+    ttmode.c_lflag &= ~ECHO;
+    QVERIFY(::tcsetattr(pty.slaveFd(), TCSANOW, &ttmode) == 0);
+    QTRY_COMPARE(changes, 1);
+    QVERIFY(!echo);
+    QVERIFY(pty.tcGetAttr(&ttmode));
+    QVERIFY(!(ttmode.c_lflag & ECHO));
+
+    // our own changes are not reported
+    QVERIFY(pty.setEcho(true));
+    QTest::qWait(200);
+    QCOMPARE(changes, 1);
+    QVERIFY(::tcgetattr(pty.slaveFd(), &ttmode) == 0);
+    QVERIFY(ttmode.c_lflag & ECHO);
+
+    QVERIFY(pty.setTermiosTracking(false));
+    QVERIFY(!pty.isTermiosTracking());
+}
+
+void KPtyDeviceTest::test_foreground_tracking()
+{
+    KPtyProcess p;
+    p.setProgram("/bin/sh", QStringList() << "-c" << "echo started; sleep 2");
+    p.setPtyChannels(KPtyProcess::AllChannels);
+    p.pty()->setForegroundProcessTracking(true, 10);
+    QVERIFY(p.pty()->isForegroundProcessTracking());
+    QCOMPARE(p.pty()->foregroundProcessId(), qint64(-1));
+
+    QSignalSpy spy(p.pty(), &KPtyDevice::foregroundProcessChanged);
+    p.start();
+    QVERIFY(p.waitForStarted());
+
+    // the child leads the foreground process group of its controlling tty
+    QVERIFY(spy.wait(2000));
+    QCOMPARE(p.pty()->foregroundProcessId(), p.processId());
+    QCOMPARE(spy.first().at(0).toLongLong(), p.processId());
+#ifdef Q_OS_LINUX
+    QVERIFY(!p.pty()->foregroundProcessName().isEmpty());
+#endif
+
+    p.pty()->setForegroundProcessTracking(false);
+    QCOMPARE(p.pty()->foregroundProcessId(), qint64(-1));
+
+    p.terminate();
+    p.waitForFinished();
+}
+
+void KPtyDeviceTest::test_wait_for_any()
+{
+    KPtyDevice quiet;
+    KPtyDevice busy;
+    QVERIFY(quiet.open());
+    QVERIFY(busy.open());
+    const QList<KPtyDevice *> devices{&quiet, &busy};
+
+    QVERIFY(KPtyDevice::waitForAny(devices, QDeadlineTimer(100)).isEmpty());
+
+    QCOMPARE(::write(busy.slaveFd(), "hello\n", 6), ssize_t(6));
+    QCOMPARE(KPtyDevice::waitForAny(devices, QDeadlineTimer(1000)), QList<KPtyDevice *>{&busy});
+    QVERIFY(busy.readAll().startsWith("hello"));
+
+    // writing counts as progress as well
+    quiet.write("x");
+    QCOMPARE(KPtyDevice::waitForAny(devices, QDeadlineTimer(1000)), QList<KPtyDevice *>{&quiet});
+    QCOMPARE(quiet.bytesToWrite(), qint64(0));
+
+    // nothing to wait for
+    quiet.setSuspended(true);
+    busy.setSuspended(true);
+    QVERIFY(KPtyDevice::waitForAny(devices).isEmpty());
+}
+
+void KPtyDeviceTest::test_idle_release()
+{
+    KPtyDevice pty;
+    QVERIFY(pty.open());
+    pty.setEcho(false);
+    pty.setIdleReleaseTimeout(50);
+    QCOMPARE(pty.idleReleaseTimeout(), 50);
+
+    // the resources are allocated again on demand after each idle period
+    for (int i = 0; i < 2; ++i) {
+        QCOMPARE(::write(pty.slaveFd(), "out", 3), ssize_t(3));
+        QVERIFY(pty.waitForReadyRead(1000));
+        QCOMPARE(pty.readAll(), QByteArray("out"));
+
+        QCOMPARE(pty.write("in"), qint64(2));
+        QVERIFY(pty.waitForBytesWritten(1000));
+        char buf[2];
+        QCOMPARE(::read(pty.slaveFd(), buf, 2), ssize_t(2));
+        QCOMPARE(QByteArray(buf, 2), QByteArray("in"));
+
+        QTest::qWait(200);
+    }
+
+    // unconsumed data survives
+    QCOMPARE(::write(pty.slaveFd(), "kept", 4), ssize_t(4));
+    QVERIFY(pty.waitForReadyRead(1000));
+    QTest::qWait(200);
+    QCOMPARE(pty.readAll(), QByteArray("kept"));
+}
+
+void KPtyDeviceTest::test_utf8_reads()
+{
+    KPtyDevice pty;
+    QVERIFY(openRawPty(&pty));
+
+    // incomplete sequences are held back until they are complete
+    writeSlaveAndWait(&pty, "a\xc3");
+    QCOMPARE(pty.utf8BytesAvailable(), qint64(1));
+    QCOMPARE(pty.readUtf8(), QByteArray("a"));
+    QCOMPARE(pty.readUtf8(), QByteArray());
+    writeSlaveAndWait(&pty, "\xa4\xe2\x82");
+    QCOMPARE(pty.readText(), QString::fromUtf8("\xc3\xa4"));
+    writeSlaveAndWait(&pty, "\xac\xf0\x9f\x98\x80");
+    QCOMPARE(pty.readText(), QString::fromUtf8("\xe2\x82\xac\xf0\x9f\x98\x80"));
+
+    // so is a sequence cut by the size limit
+    writeSlaveAndWait(&pty, "\xc3\xa4\xc3\xa4");
+    QCOMPARE(pty.readUtf8(3), QByteArray("\xc3\xa4"));
+    QCOMPARE(pty.readUtf8(3), QByteArray("\xc3\xa4"));
+
+    // invalid sequences never complete, so they are not held back
+    writeSlaveAndWait(&pty, "b\xff");
+    QCOMPARE(pty.readUtf8(), QByteArray("b\xff"));
+    writeSlaveAndWait(&pty, "\xc0");
+    QCOMPARE(pty.readUtf8(), QByteArray("\xc0"));
+}
+
+void KPtyDeviceTest::test_tokenizer()
+{
+    KPtyDevice pty;
+    QVERIFY(openRawPty(&pty));
+
+    auto describe = [&pty]() {
+        QList<QByteArray> result;
+        for (const KPtyDevice::Run &run : pty.runs()) {
+            result << (run.type == KPtyDevice::RunType::Text ? "T" : "C") + QByteArray::number(run.offset) + ':' + QByteArray::number(run.length);
+        }
+        return result.join(' ');
+    };
+
+    // output buffered before enabling is split as well
+    writeSlaveAndWait(&pty, "abc\x1b[1;2Hdef");
+    QCOMPARE(describe(), QByteArray());
+    pty.setTokenizing(true);
+    QVERIFY(pty.isTokenizing());
+    QCOMPARE(describe(), QByteArray("T0:3 C3:6 T9:3"));
+
+    // adjacent sequences form one run, incomplete ones grow
+    writeSlaveAndWait(&pty, "\r\n\x1b]0;title\x07gh\x1b[3");
+    QCOMPARE(describe(), QByteArray("T0:3 C3:6 T9:3 C12:12 T24:2 C26:3"));
+    writeSlaveAndWait(&pty, "1mxyz\x1bP1$q\x1b\\");
+    QCOMPARE(describe(), QByteArray("T0:3 C3:6 T9:3 C12:12 T24:2 C26:5 T31:3 C34:7"));
+
+    // offsets are relative to the next byte to read
+    QCOMPARE(pty.read(10), QByteArray("abc\x1b[1;2Hd"));
+    QCOMPARE(describe(), QByteArray("T0:2 C2:12 T14:2 C16:5 T21:3 C24:7"));
+    pty.readAll();
+    QCOMPARE(describe(), QByteArray());
+
+    // long text exercises the vector kernels and their tails
+    QByteArray text(100, 'x');
+    text[70] = '\x7f';
+    text[71] = '\t';
+    writeSlaveAndWait(&pty, text);
+    QCOMPARE(describe(), QByteArray("T0:70 C70:2 T72:28"));
+
+    pty.setTokenizing(false);
+    QCOMPARE(describe(), QByteArray());
+}
+
+void KPtyDeviceTest::test_read_chunk_size()
+{
+    KPtyDevice pty;
+    QVERIFY(openRawPty(&pty));
+
+    // limits are rounded to powers of two
+    pty.setReadChunkSizeLimits(1000, 5000);
+    QCOMPARE(pty.minimumReadChunkSize(), 1024);
+    QCOMPARE(pty.maximumReadChunkSize(), 8192);
+    QVERIFY(pty.readChunkSize() >= 1024 && pty.readChunkSize() <= 8192);
+
+    pty.setReadChunkSizeLimits(1024, 1024);
+    QCOMPARE(pty.readChunkSize(), 1024);
+    pty.setReadChunkSizeLimits(1024, 65536);
+
+    // a burst grows the chunk size, and so do the reads
+    const QByteArray burst(3000, 'x');
+    QCOMPARE(::write(pty.slaveFd(), burst.constData(), burst.size()), ssize_t(burst.size()));
+    QByteArray received;
+    while (received.size() < burst.size() && pty.waitForReadyRead(1000)) {
+        received += pty.readAll();
+    }
+    QCOMPARE(received, burst);
+    QVERIFY(pty.readChunkSize() > 1024);
+
+    // a series of small reads shrinks it again
+    for (int i = 0; i < 40; ++i) {
+        QCOMPARE(::write(pty.slaveFd(), "x", 1), ssize_t(1));
+        QVERIFY(pty.waitForReadyRead(1000));
+        QCOMPARE(pty.readAll(), QByteArray("x"));
+    }
+    QCOMPARE(pty.readChunkSize(), 1024);
+}
+
+void KPtyDeviceTest::test_read_sink()
+{
+    KPtyDevice pty;
+    QVERIFY(openRawPty(&pty));
+
+    QByteArray sink(8, '\0');
+    qsizetype filled = 0;
+    pty.setReadSink(
+        [&](qsizetype hint) {
+            Q_UNUSED(hint);
+            return QSpan<char>(sink.data() + filled, sink.size() - filled);
+        },
+        [&](QSpan<char> data) {
+            QCOMPARE(data.data(), sink.data() + filled);
+            filled += data.size();
+        });
+    QVERIFY(pty.hasReadSink());
+    QSignalSpy spy(&pty, &QIODevice::readyRead);
+
+    // the data goes right into the sink
+    QCOMPARE(::write(pty.slaveFd(), "hello", 5), ssize_t(5));
+    while (filled < 5) {
+        QVERIFY(pty.waitForReadyRead(1000));
+    }
+    QCOMPARE(sink.left(filled), QByteArray("hello"));
+    QCOMPARE(pty.bytesAvailable(), qint64(0));
+    QCOMPARE(pty.statistics().bytesRead, qint64(5));
+    QCOMPARE(spy.count(), 0);
+
+    // a full sink suspends reading
+    QCOMPARE(::write(pty.slaveFd(), "world", 5), ssize_t(5));
+    QTRY_VERIFY(pty.isSuspended());
+    QCOMPARE(sink, QByteArray("hellowor"));
+
+    // the rest is buffered as usual again
+    pty.setReadSink(nullptr, nullptr);
+    QVERIFY(!pty.hasReadSink());
+    pty.setSuspended(false);
+    QVERIFY(pty.waitForReadyRead(1000));
+    QCOMPARE(pty.readAll(), QByteArray("ld"));
+}
+
+QTEST_GUILESS_MAIN(KPtyDeviceTest)
+
+#include "moc_kptydevicetest.cpp"
@@ -0,0 +1,39 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef kptydevicetest_h
+#define kptydevicetest_h
+
+#include <QObject>
+
+class KPtyDeviceTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void test_rate_limit();
+    void test_urgent_write();
+    void test_discard_output();
+    void test_awaitable();
+    void test_awaitable_close();
+    void test_awaitable_read_sink();
+    void test_termios_update();
+    void test_raw_mode_restore();
+    void test_winsize_coalescing();
+    void test_packet_mode();
+    void test_termios_tracking();
+    void test_foreground_tracking();
+    void test_wait_for_any();
+    void test_idle_release();
+    void test_utf8_reads();
+    void test_tokenizer();
+    void test_read_chunk_size();
+    void test_read_sink();
+};
+
+#endif
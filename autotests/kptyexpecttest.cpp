@@ -0,0 +1,120 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kptyexpecttest.h"
+#include "kptytesthelpers.h"
+
+#include <QRegularExpression>
+#include <QSignalSpy>
+#include <QTest>
+#include <kptydevice.h>
+#include <kptyexpect.h>
+
+void KPtyExpectTest::test_literals()
+{
+    KPtyDevice pty;
+    QVERIFY(openRawPty(&pty));
+
+    KPtyExpect expect(&pty);
+    QCOMPARE(expect.addPattern(QByteArray("Password: ")), 0);
+    QCOMPARE(expect.addPattern(QByteArray("login: ")), 1);
+    QCOMPARE(expect.addPattern(QByteArray("in: ")), 2);
+    QSignalSpy spy(&expect, &KPtyExpect::matched);
+
+    // the match spans two reads
+    writeSlave(&pty, "Welcome\nlog");
+    QVERIFY(!expect.waitForMatch(200));
+    writeSlave(&pty, "in: ");
+    QVERIFY(expect.waitForMatch(1000));
+
+    // both patterns end at the same position, the first added one wins
+    QCOMPARE(expect.lastMatch().pattern, 1);
+    QCOMPARE(expect.lastMatch().offset, qint64(8));
+    QCOMPARE(expect.lastMatch().length, qint64(7));
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).toInt(), 1);
+    QCOMPARE(expect.readThroughMatch(), QByteArray("Welcome\nlogin: "));
+
+    writeSlave(&pty, "user\nPassword: ");
+    QVERIFY(expect.waitForMatch(1000));
+    QCOMPARE(expect.lastMatch().pattern, 0);
+    QCOMPARE(expect.lastMatch().offset, qint64(20));
+    QCOMPARE(expect.readThroughMatch(), QByteArray("user\nPassword: "));
+    QCOMPARE(pty.bytesAvailable(), qint64(0));
+
+    expect.stop();
+    QVERIFY(!expect.isActive());
+}
+
+void KPtyExpectTest::test_regex()
+{
+    KPtyDevice pty;
+    QVERIFY(openRawPty(&pty));
+
+    KPtyExpect expect(&pty);
+    expect.addPattern(QByteArray("ERROR"));
+    QCOMPARE(expect.addPattern(QRegularExpression("id=\\d+;")), 1);
+
+    writeSlave(&pty, "job id=12");
+    QVERIFY(!expect.waitForMatch(200));
+    writeSlave(&pty, "34; ERROR");
+    QVERIFY(expect.waitForMatch(1000));
+    QCOMPARE(expect.lastMatch().pattern, 1);
+    QCOMPARE(expect.lastMatch().offset, qint64(4));
+    QCOMPARE(expect.lastMatch().length, qint64(8));
+
+    // the literal following the regex match is found right away
+    QVERIFY(expect.waitForMatch(0));
+    QCOMPARE(expect.lastMatch().pattern, 0);
+    QCOMPARE(expect.readThroughMatch(), QByteArray("job id=1234; ERROR"));
+}
+
+void KPtyExpectTest::test_regex_utf8()
+{
+    KPtyDevice pty;
+    QVERIFY(openRawPty(&pty));
+
+    KPtyExpect expect(&pty);
+    expect.addPattern(QRegularExpression(QStringLiteral("\\x{fffd} grüß")));
+
+    // the last character is split across writes
+    writeSlave(&pty, "\xff gr\xc3\xbc\xc3");
+    QVERIFY(!expect.waitForMatch(200));
+    writeSlave(&pty, "\x9f!");
+    QVERIFY(expect.waitForMatch(1000));
+    QCOMPARE(expect.lastMatch().offset, qint64(0));
+    QCOMPARE(expect.lastMatch().length, qint64(8));
+    QCOMPARE(expect.readThroughMatch(), QByteArray("\xff gr\xc3\xbc\xc3\x9f"));
+}
+
+void KPtyExpectTest::test_timeout()
+{
+    KPtyDevice pty;
+    QVERIFY(openRawPty(&pty));
+
+    KPtyExpect expect(&pty);
+    expect.addPattern(QByteArray("$ "));
+    expect.setTimeout(100);
+    QCOMPARE(expect.timeout(), 100);
+    QSignalSpy timedOutSpy(&expect, &KPtyExpect::timedOut);
+    QSignalSpy matchedSpy(&expect, &KPtyExpect::matched);
+    expect.start();
+    QVERIFY(expect.isActive());
+
+    writeSlave(&pty, "no prompt");
+    QVERIFY(timedOutSpy.wait(1000));
+    QCOMPARE(matchedSpy.count(), 0);
+
+    writeSlave(&pty, "$ ");
+    QVERIFY(matchedSpy.wait(1000));
+    QCOMPARE(matchedSpy.at(0).at(1).toLongLong(), qint64(9));
+}
+
+QTEST_MAIN(KPtyExpectTest)
+
+#include "moc_kptyexpecttest.cpp"
@@ -0,0 +1,25 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef kptyexpecttest_h
+#define kptyexpecttest_h
+
+#include <QObject>
+
+class KPtyExpectTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void test_literals();
+    void test_regex();
+    void test_regex_utf8();
+    void test_timeout();
+};
+
+#endif
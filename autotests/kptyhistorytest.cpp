@@ -0,0 +1,97 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kptyhistorytest.h"
+
+#include <QStandardPaths>
+#include <QTest>
+#include <kptyhistory.h>
+
+#include <unistd.h>
+
+void KPtyHistoryTest::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void KPtyHistoryTest::test_append_read()
+{
+    const qint64 pageSize = sysconf(_SC_PAGESIZE);
+
+    // a single resident segment forces remapping on reads
+    KPtyHistory history(pageSize, 1);
+    QVERIFY(history.open());
+
+    QByteArray data;
+    for (int i = 0; data.size() < 5 * pageSize; ++i) {
+        data += QByteArray::number(i) + ' ';
+    }
+    for (qint64 pos = 0; pos < data.size(); pos += 1000) {
+        QVERIFY(history.append(data.constData() + pos, qMin<qint64>(1000, data.size() - pos)));
+    }
+
+    QCOMPARE(history.startOffset(), qint64(0));
+    QCOMPARE(history.endOffset(), qint64(data.size()));
+    QCOMPARE(history.read(0, data.size()), data);
+    QCOMPARE(history.read(pageSize - 10, 20), data.mid(pageSize - 10, 20));
+    QCOMPARE(history.read(3 * pageSize + 7, 2 * pageSize), data.mid(3 * pageSize + 7, 2 * pageSize));
+    QCOMPARE(history.read(data.size(), 10), QByteArray());
+}
+
+void KPtyHistoryTest::test_lines()
+{
+    const qint64 pageSize = sysconf(_SC_PAGESIZE);
+
+    KPtyHistory history(pageSize, 2);
+    QVERIFY(history.open());
+
+    QByteArray data;
+    for (int i = 0; i < 3000; ++i) {
+        data += "line " + QByteArray::number(i) + '\n';
+    }
+    data += "unterminated";
+    QVERIFY(history.append(data.constData(), data.size()));
+
+    QCOMPARE(history.startLine(), qint64(0));
+    QCOMPARE(history.lineCount(), qint64(3001));
+    QCOMPARE(history.lineOffset(0), qint64(0));
+    for (int line : {1, 255, 256, 257, 1000, 2999}) {
+        QCOMPARE(history.readLines(line, 1), "line " + QByteArray::number(line) + '\n');
+    }
+    QCOMPARE(history.readLines(2999, 5), QByteArray("line 2999\nunterminated"));
+    QCOMPARE(history.lineOffset(3001), qint64(-1));
+}
+
+void KPtyHistoryTest::test_drop_oldest()
+{
+    const qint64 pageSize = sysconf(_SC_PAGESIZE);
+
+    KPtyHistory history(pageSize, 2);
+    QVERIFY(history.open());
+    history.setRetentionPolicy(KPtyHistory::DropOldest, 2 * pageSize);
+
+    const QByteArray line(99, 'x');
+    for (int i = 0; i < 1000; ++i) {
+        QVERIFY(history.append(line.constData(), line.size()));
+        QVERIFY(history.append("\n", 1));
+    }
+
+    QCOMPARE(history.endOffset(), qint64(100000));
+    QVERIFY(history.endOffset() - history.startOffset() >= 2 * pageSize);
+    QVERIFY(history.endOffset() - history.startOffset() <= 3 * pageSize);
+    QCOMPARE(history.read(0, 10), QByteArray());
+    QCOMPARE(history.lineOffset(0), qint64(-1));
+
+    const qint64 first = history.startLine();
+    QCOMPARE(history.lineOffset(first) % 100, qint64(0));
+    QCOMPARE(history.readLines(first, 1), line + '\n');
+}
+
+QTEST_GUILESS_MAIN(KPtyHistoryTest)
+
+#include "moc_kptyhistorytest.cpp"
@@ -0,0 +1,25 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef kptyhistorytest_h
+#define kptyhistorytest_h
+
+#include <QObject>
+
+class KPtyHistoryTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void test_append_read();
+    void test_lines();
+    void test_drop_oldest();
+};
+
+#endif
@@ -0,0 +1,89 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kptymemorybenchmark.h"
+
+#include <QDebug>
+#include <QTest>
+#include <kptydevice.h>
+
+#include <memory>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+static const int idleSessions = 10000;
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#define HAVE_MALLINFO2 1
+static qint64 heapInUse()
+{
+    return mallinfo2().uordblks;
+}
+#endif
+
+// Measures the heap used per open device, once after some traffic, and
+// once the device released its resources after being idle.
+void KPtyMemoryBenchmark::benchmark_idle_sessions()
+{
+#ifndef HAVE_MALLINFO2
+    QSKIP("Measuring the heap requires glibc");
+#else
+    // each session takes two descriptors
+    struct rlimit limit;
+    if (!getrlimit(RLIMIT_NOFILE, &limit)) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    std::vector<std::unique_ptr<KPtyDevice>> devices;
+    devices.reserve(idleSessions);
+    const qint64 before = heapInUse();
+    for (int i = 0; i < idleSessions; ++i) {
+        auto device = std::make_unique<KPtyDevice>();
+        if (!device->open()) {
+            break; // out of ptys or descriptors
+        }
+        devices.push_back(std::move(device));
+    }
+    const qint64 count = devices.size();
+    if (count < 100) {
+        QSKIP("Can't open enough ptys");
+    }
+    const qint64 opened = heapInUse();
+
+    for (const auto &device : devices) {
+        device->setEcho(false);
+        device->setIdleReleaseTimeout(100);
+        QCOMPARE(::write(device->slaveFd(), "x", 1), ssize_t(1));
+        device->write("y");
+        QVERIFY(device->waitForReadyRead(1000));
+        QVERIFY(device->waitForBytesWritten(1000));
+        device->readAll();
+        char c;
+        QCOMPARE(::read(device->slaveFd(), &c, 1), ssize_t(1));
+    }
+    const qint64 used = heapInUse();
+
+    QTest::qWait(300);
+    const qint64 idle = heapInUse();
+
+    qDebug() << count << "sessions, per session: opened" << (opened - before) / count << "bytes, used" << (used - before) / count
+             << "bytes, idle" << (idle - before) / count << "bytes";
+    QVERIFY(idle < used);
+    QTest::setBenchmarkResult(qreal(idle - before) / count, QTest::BytesAllocated);
+#endif
+}
+
+QTEST_GUILESS_MAIN(KPtyMemoryBenchmark)
+
+#include "moc_kptymemorybenchmark.cpp"
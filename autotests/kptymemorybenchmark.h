@@ -0,0 +1,22 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef kptymemorybenchmark_h
+#define kptymemorybenchmark_h
+
+#include <QObject>
+
+class KPtyMemoryBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void benchmark_idle_sessions();
+};
+
+#endif
@@ -9,12 +9,18 @@
 #include "kptyprocesstest.h"
 
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QScopeGuard>
 #include <QSignalSpy>
 #include <QStandardPaths>
+#include <QTemporaryFile>
 #include <QTest>
 #include <QThread>
 #include <kptydevice.h>
 
+// defined in kptyprocess.cpp
+extern KPTY_EXPORT bool kpty_use_pidfd;
+
 void KPtyProcessTest::test_suspend_pty()
 {
     KPtyProcess p;
@@ -47,6 +53,126 @@ void KPtyProcessTest::test_suspend_pty()
     p.waitForFinished();
 }
 
+void KPtyProcessTest::test_wait_pty_finished()
+{
+    KPtyProcess p;
+    p.setProgram("/bin/sh", QStringList() << "-c" << "head -c 100000 /dev/zero; echo done; exit 3");
+    p.setPtyChannels(KPtyProcess::AllChannels);
+    p.start();
+
+    // far more output than the pty holds, read while waiting
+    QVERIFY(p.waitForPtyFinished(5000));
+    QCOMPARE(p.state(), QProcess::NotRunning);
+    QCOMPARE(p.exitCode(), 3);
+    const QByteArray output = p.pty()->readAll();
+    QCOMPARE(output.size(), 100000 + 6);
+    QVERIFY(output.endsWith("done\r\n"));
+
+    KPtyProcess sleeper;
+    sleeper.setProgram("/bin/sh", QStringList() << "-c" << "echo sleeping; sleep 5");
+    sleeper.setPtyChannels(KPtyProcess::AllChannels);
+    sleeper.start();
+    QElapsedTimer timer;
+    timer.start();
+    QVERIFY(!sleeper.waitForPtyFinished(300));
+    QVERIFY(timer.elapsed() >= 250);
+    QCOMPARE(sleeper.pty()->readAll(), QByteArray("sleeping\r\n"));
+    sleeper.terminate();
+    QVERIFY(sleeper.waitForPtyFinished(5000));
+    QVERIFY(!sleeper.waitForPtyFinished(100));
+}
+
+void KPtyProcessTest::test_wait_pty_finished_without_pidfd()
+{
+    // the exit is found by polling then
+    kpty_use_pidfd = false;
+    const auto restore = qScopeGuard([] {
+        kpty_use_pidfd = true;
+    });
+
+    KPtyProcess p;
+    p.setProgram("/bin/sh", QStringList() << "-c" << "echo done; exit 3");
+    p.setPtyChannels(KPtyProcess::AllChannels);
+    p.start();
+    QElapsedTimer timer;
+    timer.start();
+    QVERIFY(p.waitForPtyFinished(-1));
+    QVERIFY(timer.elapsed() < 5000);
+    QCOMPARE(p.exitCode(), 3);
+    QCOMPARE(p.pty()->readAll(), QByteArray("done\r\n"));
+
+    KPtyProcess sleeper;
+    sleeper.setProgram("/bin/sh", QStringList() << "-c" << "sleep 5");
+    sleeper.setPtyChannels(KPtyProcess::AllChannels);
+    sleeper.start();
+    QVERIFY(!sleeper.waitForPtyFinished(200));
+    sleeper.kill();
+    QVERIFY(sleeper.waitForPtyFinished(5000));
+}
+
+void KPtyProcessTest::test_capture_output()
+{
+    KPtyProcess p;
+    p.setProgram("/bin/sh", QStringList() << "-c" << "echo captured; exit 3");
+    p.setPtyChannels(KPtyProcess::AllChannels);
+    p.start();
+
+    QByteArray buffer("kept ");
+    const KPtyProcess::CaptureResult result = p.captureOutput(&buffer, 5000);
+    QVERIFY(result.finished);
+    QCOMPARE(result.exitCode, 3);
+    QCOMPARE(result.exitStatus, QProcess::NormalExit);
+    QCOMPARE(buffer, QByteArray("kept captured\r\n"));
+    QCOMPARE(result.capturedSize, qint64(10));
+    QVERIFY(!p.pty()->bytesAvailable());
+
+    // far more output than the pty holds, written through to a file
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    KPtyProcess big;
+    big.setProgram("/bin/sh", QStringList() << "-c" << "head -c 100000 /dev/zero");
+    big.setPtyChannels(KPtyProcess::AllChannels);
+    big.start();
+    const KPtyProcess::CaptureResult written = big.captureOutput(file.handle(), 5000);
+    QVERIFY(written.finished);
+    QCOMPARE(written.exitCode, 0);
+    QCOMPARE(written.capturedSize, qint64(100000));
+    QCOMPARE(file.size(), qint64(100000));
+
+    KPtyProcess sleeper;
+    sleeper.setProgram("/bin/sh", QStringList() << "-c" << "sleep 5");
+    sleeper.setPtyChannels(KPtyProcess::AllChannels);
+    sleeper.start();
+    QByteArray none;
+    QVERIFY(!sleeper.captureOutput(&none, 200).finished);
+    sleeper.kill();
+    QVERIFY(sleeper.waitForPtyFinished(5000));
+}
+
+void KPtyProcessTest::test_capture_output_without_pidfd()
+{
+    kpty_use_pidfd = false;
+    const auto restore = qScopeGuard([] {
+        kpty_use_pidfd = true;
+    });
+
+    KPtyProcess p;
+    p.setProgram("/bin/sh", QStringList() << "-c" << "echo captured; exit 3");
+    p.setPtyChannels(KPtyProcess::AllChannels);
+    p.start();
+
+    // the capture ends with the process, not at the deadline
+    QElapsedTimer timer;
+    timer.start();
+    QByteArray buffer;
+    const KPtyProcess::CaptureResult result = p.captureOutput(&buffer, 10000);
+    QVERIFY(timer.elapsed() < 5000);
+    QVERIFY(result.finished);
+    QCOMPARE(result.exitCode, 3);
+    QCOMPARE(result.exitStatus, QProcess::NormalExit);
+    QCOMPARE(buffer, QByteArray("captured\r\n"));
+}
+
 void KPtyProcessTest::test_shared_pty()
 {
     // start a first process
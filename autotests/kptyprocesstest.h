@@ -23,6 +23,10 @@ private Q_SLOTS:
     void test_ctty();
     void test_shared_pty();
     void test_suspend_pty();
+    void test_wait_pty_finished();
+    void test_wait_pty_finished_without_pidfd();
+    void test_capture_output();
+    void test_capture_output_without_pidfd();
 
     // for pty_signals
 public Q_SLOTS:
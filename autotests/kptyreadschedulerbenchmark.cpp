@@ -0,0 +1,109 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kptyreadschedulerbenchmark.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTest>
+#include <QTimer>
+#include <kptydevice.h>
+#include <kptyprocess.h>
+#include <kptyreadscheduler.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+static const int bulkSessions = 8;
+static const int roundTrips = 50;
+
+void KPtyReadSchedulerBenchmark::benchmark_interactive_latency_data()
+{
+    QTest::addColumn<bool>("scheduled");
+
+    QTest::newRow("unscheduled") << false;
+    QTest::newRow("scheduled") << true;
+}
+
+// Measures the time a line typed into an interactive session takes to be
+// echoed back while several other sessions flood their ptys with output.
+void KPtyReadSchedulerBenchmark::benchmark_interactive_latency()
+{
+    QFETCH(bool, scheduled);
+
+    KPtyReadScheduler scheduler;
+
+    std::vector<std::unique_ptr<KPtyProcess>> bulk;
+    qint64 bulkBytes = 0;
+    for (int i = 0; i < bulkSessions; ++i) {
+        auto p = std::make_unique<KPtyProcess>();
+        p->setProgram("cat", QStringList() << "/dev/zero");
+        p->setPtyChannels(KPtyProcess::AllChannels);
+        KPtyDevice *pty = p->pty();
+        connect(pty, &QIODevice::readyRead, this, [pty, &bulkBytes]() {
+            bulkBytes += pty->readAll().size();
+        });
+        if (scheduled) {
+            scheduler.addDevice(pty);
+        }
+        p->start();
+        bulk.push_back(std::move(p));
+    }
+
+    KPtyProcess echo;
+    echo.setProgram("cat");
+    echo.setPtyChannels(KPtyProcess::AllChannels);
+    echo.pty()->setEcho(false);
+    if (scheduled) {
+        scheduler.addDevice(echo.pty());
+    }
+    echo.start();
+    QVERIFY(echo.waitForStarted());
+
+    // let the flood build up
+    QTest::qWait(200);
+
+    QEventLoop loop;
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    connect(&timeout, &QTimer::timeout, &loop, [&loop]() {
+        loop.exit(1);
+    });
+    connect(echo.pty(), &QIODevice::readyRead, &loop, [&loop, &echo]() {
+        if (echo.pty()->canReadLine()) {
+            echo.pty()->readAll();
+            loop.quit();
+        }
+    });
+
+    QList<qint64> latencies;
+    QElapsedTimer timer;
+    const qint64 bulkStart = bulkBytes;
+    QElapsedTimer total;
+    total.start();
+    for (int i = 0; i < roundTrips; ++i) {
+        timer.start();
+        echo.pty()->write("ping\n");
+        timeout.start(5000);
+        QCOMPARE(loop.exec(), 0);
+        latencies << timer.nsecsElapsed();
+    }
+    const qint64 elapsed = total.elapsed();
+
+    std::sort(latencies.begin(), latencies.end());
+    const qint64 median = latencies.at(latencies.size() / 2);
+    qDebug() << "median" << median / 1000 << "us, worst" << latencies.last() / 1000 << "us, bulk throughput"
+             << (bulkBytes - bulkStart) / qMax<qint64>(1, elapsed) / 1000 << "MB/s";
+    QTest::setBenchmarkResult(median, QTest::WalltimeNanoseconds);
+}
+
+QTEST_GUILESS_MAIN(KPtyReadSchedulerBenchmark)
+
+#include "moc_kptyreadschedulerbenchmark.cpp"
@@ -0,0 +1,23 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef kptyreadschedulerbenchmark_h
+#define kptyreadschedulerbenchmark_h
+
+#include <QObject>
+
+class KPtyReadSchedulerBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void benchmark_interactive_latency_data();
+    void benchmark_interactive_latency();
+};
+
+#endif
@@ -0,0 +1,48 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kptyreadschedulertest.h"
+
+#include <QTest>
+#include <kptydevice.h>
+#include <kptyprocess.h>
+#include <kptyreadscheduler.h>
+
+void KPtyReadSchedulerTest::test_quantum()
+{
+    KPtyReadScheduler scheduler;
+    scheduler.setQuantum(1000);
+
+    KPtyProcess p;
+    p.setProgram("/bin/sh", QStringList() << "-c" << "head -c 100000 /dev/zero; sleep 5");
+    p.setPtyChannels(KPtyProcess::AllChannels);
+    scheduler.addDevice(p.pty());
+    QCOMPARE(scheduler.devices(), QList<KPtyDevice *>() << p.pty());
+
+    qint64 received = 0;
+    qint64 largestRead = 0;
+    connect(p.pty(), &QIODevice::readyRead, this, [&]() {
+        const qint64 size = p.pty()->readAll().size();
+        received += size;
+        largestRead = qMax(largestRead, size);
+    });
+    p.start();
+
+    QTRY_COMPARE_WITH_TIMEOUT(received, qint64(100000), 5000);
+    QVERIFY(largestRead <= 1000);
+
+    scheduler.removeDevice(p.pty());
+    QVERIFY(scheduler.devices().isEmpty());
+
+    p.terminate();
+    p.waitForFinished();
+}
+
+QTEST_GUILESS_MAIN(KPtyReadSchedulerTest)
+
+#include "moc_kptyreadschedulertest.cpp"
@@ -0,0 +1,22 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef kptyreadschedulertest_h
+#define kptyreadschedulertest_h
+
+#include <QObject>
+
+class KPtyReadSchedulerTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void test_quantum();
+};
+
+#endif
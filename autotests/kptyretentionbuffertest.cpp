@@ -0,0 +1,72 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kptyretentionbuffertest.h"
+
+#include <QTest>
+#include <QThreadPool>
+#include <kptyretentionbuffer.h>
+
+void KPtyRetentionBufferTest::test_replay_data()
+{
+    QTest::addColumn<int>("compression");
+
+    QTest::newRow("none") << int(KPtyRetentionBuffer::NoCompression);
+    QTest::newRow("default") << int(KPtyRetentionBuffer::defaultCompression());
+}
+
+void KPtyRetentionBufferTest::test_replay()
+{
+    QFETCH(int, compression);
+
+    KPtyRetentionBuffer buffer(10000, 1024);
+    buffer.setCompression(KPtyRetentionBuffer::Compression(compression));
+
+    QByteArray all;
+    for (int i = 0; i < 500; ++i) {
+        const QByteArray line = QByteArray(i % 37 + 1, char('a' + i % 26)) + QByteArray::number(i) + '\n';
+        all += line;
+        buffer.append(line.constData(), line.size());
+    }
+    QThreadPool::globalInstance()->waitForDone();
+
+    QCOMPARE(buffer.size(), qint64(10000));
+    QCOMPARE(buffer.replay(), all.right(10000));
+
+    buffer.clear();
+    QCOMPARE(buffer.size(), qint64(0));
+    QCOMPARE(buffer.replay(), QByteArray());
+}
+
+void KPtyRetentionBufferTest::test_compression()
+{
+    if (KPtyRetentionBuffer::defaultCompression() == KPtyRetentionBuffer::NoCompression) {
+        QSKIP("KPty was built without compression support");
+    }
+
+    KPtyRetentionBuffer buffer(1024 * 1024, 16 * 1024);
+    const QByteArray line("drwxr-xr-x  2 user user  4096 Jan  1 00:00 directory\r\n");
+    for (int i = 0; i < 20000; ++i) {
+        buffer.append(line.constData(), line.size());
+    }
+    QThreadPool::globalInstance()->waitForDone();
+
+    const KPtyRetentionBuffer::Statistics stats = buffer.statistics();
+    QVERIFY(stats.compressedBlocks > 0);
+    QVERIFY(stats.compressionRatio() > 5);
+    QVERIFY(stats.compressionTime > 0);
+
+    const QByteArray replay = buffer.replay();
+    QCOMPARE(replay.size(), qsizetype(1024 * 1024));
+    QVERIFY(replay.endsWith(line));
+    QVERIFY(buffer.statistics().decompressionTime > 0);
+}
+
+QTEST_GUILESS_MAIN(KPtyRetentionBufferTest)
+
+#include "moc_kptyretentionbuffertest.cpp"
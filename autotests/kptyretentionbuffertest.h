@@ -0,0 +1,24 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef kptyretentionbuffertest_h
+#define kptyretentionbuffertest_h
+
+#include <QObject>
+
+class KPtyRetentionBufferTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void test_replay_data();
+    void test_replay();
+    void test_compression();
+};
+
+#endif
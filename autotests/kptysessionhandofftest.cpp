@@ -0,0 +1,125 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kptysessionhandofftest.h"
+#include "kptytesthelpers.h"
+
+#include <QTest>
+#include <kptydevice.h>
+#include <kptysubscription.h>
+
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+void KPtySessionHandoffTest::test_handoff()
+{
+    int sockets[2];
+    QVERIFY(!socketpair(AF_UNIX, SOCK_STREAM, 0, sockets));
+
+    KPtyDevice sender;
+    QVERIFY(openRawPty(&sender));
+    sender.setWinSizeCoalescing(1000, -1);
+    QVERIFY(sender.requestWinSize(30, 100, 0, 0));
+
+    // leave data in both directions in the buffers of the sender
+    QCOMPARE(::write(sender.slaveFd(), "hello", 5), ssize_t(5));
+    while (sender.bytesAvailable() < 5) {
+        QVERIFY(sender.waitForReadyRead(1000));
+    }
+    QCOMPARE(sender.read(1), QByteArray("h"));
+    QCOMPARE(sender.write("input"), qint64(5));
+
+    QVERIFY(sender.sendSession(sockets[0]));
+    QCOMPARE(sender.masterFd(), -1);
+
+    KPtyDevice receiver;
+    QVERIFY(receiver.receiveSession(sockets[1]));
+    ::close(sockets[0]);
+    ::close(sockets[1]);
+
+    QCOMPARE(receiver.readAll(), QByteArray("ello"));
+    QCOMPARE(::write(receiver.slaveFd(), "world", 5), ssize_t(5));
+    QVERIFY(receiver.waitForReadyRead(1000));
+    QCOMPARE(receiver.readAll(), QByteArray("world"));
+
+    QVERIFY(receiver.waitForBytesWritten(1000));
+    char buf[5];
+    QCOMPARE(::read(receiver.slaveFd(), buf, sizeof(buf)), ssize_t(5));
+    QCOMPARE(QByteArray(buf, 5), QByteArray("input"));
+
+    // the coalesced window size was applied on the way
+    struct winsize winSize;
+    QVERIFY(!ioctl(receiver.masterFd(), TIOCGWINSZ, &winSize));
+    QCOMPARE(winSize.ws_row, (unsigned short)30);
+    QCOMPARE(winSize.ws_col, (unsigned short)100);
+}
+
+void KPtySessionHandoffTest::test_invalid_session()
+{
+    int sockets[2];
+    QVERIFY(!socketpair(AF_UNIX, SOCK_STREAM, 0, sockets));
+    QCOMPARE(::write(sockets[0], "garbage", 7), ssize_t(7));
+    ::close(sockets[0]);
+
+    KPtyDevice receiver;
+    QVERIFY(!receiver.receiveSession(sockets[1], 1000));
+    QCOMPARE(receiver.masterFd(), -1);
+    ::close(sockets[1]);
+}
+
+void KPtySessionHandoffTest::test_receive_with_subscriptions()
+{
+    int sockets[2];
+    QVERIFY(!socketpair(AF_UNIX, SOCK_STREAM, 0, sockets));
+
+    KPtyDevice sender;
+    QVERIFY(openRawPty(&sender));
+    QCOMPARE(::write(sender.slaveFd(), "hello", 5), ssize_t(5));
+    while (sender.bytesAvailable() < 5) {
+        QVERIFY(sender.waitForReadyRead(1000));
+    }
+    QCOMPARE(sender.read(1), QByteArray("h"));
+    QVERIFY(sender.sendSession(sockets[0]));
+
+    // the receiver has subscriptions from an earlier session already, one
+    // of which is behind
+    KPtyDevice receiver;
+    QVERIFY(openRawPty(&receiver));
+    KPtySubscription recorder(&receiver);
+    KPtySubscription viewer(&receiver);
+    QCOMPARE(::write(receiver.slaveFd(), "old", 3), ssize_t(3));
+    while (receiver.bytesAvailable() < 3) {
+        QVERIFY(receiver.waitForReadyRead(1000));
+    }
+    QCOMPARE(receiver.readAll(), QByteArray("old"));
+    QCOMPARE(viewer.readAll(), QByteArray("old"));
+    receiver.close();
+
+    QVERIFY(receiver.receiveSession(sockets[1]));
+    ::close(sockets[0]);
+    ::close(sockets[1]);
+
+    // offsets continue those of the sender
+    QCOMPARE(viewer.streamPosition(), qint64(1));
+    QCOMPARE(recorder.streamPosition(), qint64(-2));
+    QCOMPARE(recorder.readAll(), QByteArray("oldello"));
+    QCOMPARE(viewer.readAll(), QByteArray("ello"));
+    QCOMPARE(receiver.readAll(), QByteArray("ello"));
+
+    QCOMPARE(::write(receiver.slaveFd(), "world", 5), ssize_t(5));
+    QVERIFY(receiver.waitForReadyRead(1000));
+    QCOMPARE(receiver.readAll(), QByteArray("world"));
+    QCOMPARE(recorder.readAll(), QByteArray("world"));
+    QCOMPARE(viewer.readAll(), QByteArray("world"));
+    QCOMPARE(viewer.streamPosition(), qint64(10));
+}
+
+QTEST_GUILESS_MAIN(KPtySessionHandoffTest)
+
+#include "moc_kptysessionhandofftest.cpp"
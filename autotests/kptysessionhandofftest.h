@@ -0,0 +1,24 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef kptysessionhandofftest_h
+#define kptysessionhandofftest_h
+
+#include <QObject>
+
+class KPtySessionHandoffTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void test_handoff();
+    void test_invalid_session();
+    void test_receive_with_subscriptions();
+};
+
+#endif
@@ -0,0 +1,90 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kptysharedringtest.h"
+#include "kptytesthelpers.h"
+
+#include <QSignalSpy>
+#include <QTest>
+#include <kptydevice.h>
+#include <kptysharedring.h>
+
+#include <unistd.h>
+
+void KPtySharedRingTest::test_export()
+{
+    KPtyDevice pty;
+    QVERIFY(openRawPty(&pty));
+    if (!pty.setSharedRingExport(4096)) {
+        QSKIP("Shared ring buffers are not supported on this platform");
+    }
+    const KPtySharedRingReader::Descriptors descriptors = pty.sharedRingDescriptors();
+    QVERIFY(descriptors.memory >= 0);
+
+    KPtySharedRingReader reader;
+    QVERIFY(reader.open(descriptors));
+    QSignalSpy spy(&reader, &QIODevice::readyRead);
+
+    writeSlave(&pty, "hello\n");
+    QVERIFY(waitForRead(&pty, 6));
+    QVERIFY(reader.waitForReadyRead(1000));
+    QCOMPARE(reader.bytesAvailable(), qint64(6));
+    QVERIFY(reader.canReadLine());
+
+    // the reader and the device consume independently
+    QCOMPARE(reader.readView().toByteArray(), QByteArray("hello\n"));
+    reader.consume(2);
+    QCOMPARE(reader.readAll(), QByteArray("llo\n"));
+    QCOMPARE(pty.readAll(), QByteArray("hello\n"));
+
+    // the notification arrives through the event loop
+    writeSlave(&pty, "world");
+    QVERIFY(spy.wait(1000));
+    QCOMPARE(reader.readAll(), QByteArray("world"));
+    QVERIFY(!reader.isFinished());
+
+    QSignalSpy finishedSpy(&reader, &QIODevice::readChannelFinished);
+    pty.setSharedRingExport(0);
+    QVERIFY(reader.isFinished());
+    QVERIFY(finishedSpy.wait(1000));
+    QVERIFY(!reader.waitForReadyRead(0));
+}
+
+void KPtySharedRingTest::test_backpressure()
+{
+    KPtyDevice pty;
+    QVERIFY(openRawPty(&pty));
+    if (!pty.setSharedRingExport(4096)) {
+        QSKIP("Shared ring buffers are not supported on this platform");
+    }
+    KPtySharedRingReader reader;
+    QVERIFY(reader.open(pty.sharedRingDescriptors()));
+
+    QByteArray data;
+    for (int i = 0; i < 6000; ++i) {
+        data.append(char('a' + i % 26));
+    }
+    writeSlave(&pty, data);
+
+    // a full ring holds back reading from the pty
+    QVERIFY(waitForRead(&pty, 4096));
+    QVERIFY(!pty.waitForReadyRead(100));
+    QCOMPARE(pty.statistics().bytesRead, qint64(4096));
+
+    // making room resumes reading, without losing anything
+    QByteArray received = reader.read(4096);
+    QVERIFY(waitForRead(&pty, 6000));
+    QVERIFY(reader.waitForReadyRead(1000));
+    received += reader.readAll();
+    QCOMPARE(received, data);
+    QCOMPARE(pty.readAll(), data);
+}
+
+QTEST_GUILESS_MAIN(KPtySharedRingTest)
+
+#include "moc_kptysharedringtest.cpp"
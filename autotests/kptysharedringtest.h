@@ -0,0 +1,23 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef kptysharedringtest_h
+#define kptysharedringtest_h
+
+#include <QObject>
+
+class KPtySharedRingTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void test_export();
+    void test_backpressure();
+};
+
+#endif
@@ -0,0 +1,117 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kptysubscriptiontest.h"
+#include "kptytesthelpers.h"
+
+#include <QSignalSpy>
+#include <QTest>
+#include <kptydevice.h>
+#include <kptysubscription.h>
+
+#include <unistd.h>
+
+void KPtySubscriptionTest::test_fanout()
+{
+    KPtyDevice pty;
+    QVERIFY(openRawPty(&pty));
+
+    KPtySubscription owner(&pty);
+    KPtySubscription recorder(&pty);
+    QVERIFY(owner.isOpen());
+    QSignalSpy spy(&recorder, &QIODevice::readyRead);
+
+    writeSlave(&pty, "hello\n");
+    QVERIFY(waitForRead(&pty, 6));
+    QVERIFY(spy.count() > 0);
+    QCOMPARE(owner.bytesAvailable(), qint64(6));
+    QVERIFY(owner.canReadLine());
+
+    // each reader has its own cursor, and so has the device
+    QCOMPARE(owner.readAll(), QByteArray("hello\n"));
+    QCOMPARE(owner.bytesAvailable(), qint64(0));
+    QCOMPARE(recorder.bytesAvailable(), qint64(6));
+    QCOMPARE(pty.readAll(), QByteArray("hello\n"));
+
+    writeSlave(&pty, "world");
+    QVERIFY(waitForRead(&pty, 11));
+    QCOMPARE(recorder.read(3), QByteArray("hel"));
+    QCOMPARE(recorder.streamPosition(), qint64(3));
+    QCOMPARE(recorder.readAll(), QByteArray("lo\nworld"));
+    QCOMPARE(owner.readAll(), QByteArray("world"));
+
+    // a late subscriber only sees new output
+    KPtySubscription late(&pty);
+    QCOMPARE(late.bytesAvailable(), qint64(0));
+    QCOMPARE(late.streamPosition(), qint64(11));
+}
+
+void KPtySubscriptionTest::test_drop_oldest()
+{
+    KPtyDevice pty;
+    QVERIFY(openRawPty(&pty));
+
+    KPtySubscription viewer(&pty);
+    viewer.setLagLimit(4);
+    QCOMPARE(viewer.lagLimit(), qint64(4));
+    QCOMPARE(viewer.lagPolicy(), KPtySubscription::DropOldest);
+    QSignalSpy spy(&viewer, &KPtySubscription::outputDropped);
+
+    writeSlave(&pty, "abcdefgh");
+    QVERIFY(waitForRead(&pty, 8));
+    QCOMPARE(viewer.droppedBytes(), qint64(4));
+    QVERIFY(spy.count() > 0);
+    QCOMPARE(viewer.readAll(), QByteArray("efgh"));
+
+    // a stalled viewer does not hold back the device
+    QCOMPARE(pty.readAll(), QByteArray("abcdefgh"));
+}
+
+void KPtySubscriptionTest::test_suspend_reading()
+{
+    KPtyDevice pty;
+    QVERIFY(openRawPty(&pty));
+
+    KPtySubscription recorder(&pty);
+    writeSlave(&pty, "abcdefgh");
+    QVERIFY(waitForRead(&pty, 8));
+    recorder.setLagLimit(4, KPtySubscription::SuspendReading);
+    writeSlave(&pty, "ij");
+
+    // nothing is read until the recorder catches up, and nothing is lost
+    QVERIFY(!pty.waitForReadyRead(200));
+    // the recorder can't catch up meanwhile, so this must not block forever
+    QVERIFY(!pty.waitForReadyRead(-1));
+    QCOMPARE(pty.statistics().bytesRead, qint64(8));
+    QCOMPARE(recorder.readAll(), QByteArray("abcdefgh"));
+    QVERIFY(waitForRead(&pty, 10));
+    QCOMPARE(recorder.readAll(), QByteArray("ij"));
+    QCOMPARE(recorder.droppedBytes(), qint64(0));
+}
+
+void KPtySubscriptionTest::test_write_only_owner()
+{
+    KPtyDevice pty;
+    QVERIFY(openRawPty(&pty, QIODevice::WriteOnly | QIODevice::Unbuffered));
+
+    KPtySubscription recorder(&pty);
+    writeSlave(&pty, "abc");
+    QVERIFY(waitForRead(&pty, 3));
+
+    // the device keeps nothing for itself
+    QCOMPARE(pty.bytesAvailable(), qint64(0));
+    QCOMPARE(recorder.readAll(), QByteArray("abc"));
+    writeSlave(&pty, "def");
+    QVERIFY(waitForRead(&pty, 6));
+    QCOMPARE(pty.bytesAvailable(), qint64(0));
+    QCOMPARE(recorder.readAll(), QByteArray("def"));
+}
+
+QTEST_GUILESS_MAIN(KPtySubscriptionTest)
+
+#include "moc_kptysubscriptiontest.cpp"
@@ -0,0 +1,25 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef kptysubscriptiontest_h
+#define kptysubscriptiontest_h
+
+#include <QObject>
+
+class KPtySubscriptionTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void test_fanout();
+    void test_drop_oldest();
+    void test_suspend_reading();
+    void test_write_only_owner();
+};
+
+#endif
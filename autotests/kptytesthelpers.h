@@ -0,0 +1,55 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef kptytesthelpers_h
+#define kptytesthelpers_h
+
+#include <QTest>
+#include <kptydevice.h>
+
+#include <termios.h>
+#include <unistd.h>
+
+// opens a pty which passes the data through unchanged
+inline bool openRawPty(KPtyDevice *pty, QIODevice::OpenMode mode = QIODevice::ReadWrite | QIODevice::Unbuffered)
+{
+    struct ::termios ttmode;
+    if (!pty->open(mode) || !pty->tcGetAttr(&ttmode)) {
+        return false;
+    }
+    cfmakeraw(&ttmode);
+    return pty->tcSetAttr(&ttmode);
+}
+
+inline void writeSlave(KPtyDevice *pty, const QByteArray &data)
+{
+    QCOMPARE(::write(pty->slaveFd(), data.constData(), data.size()), ssize_t(data.size()));
+}
+
+// waits until the device read the given amount in total
+inline bool waitForRead(KPtyDevice *pty, qint64 total)
+{
+    while (pty->statistics().bytesRead < total) {
+        if (!pty->waitForReadyRead(1000)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// writes to the slave and waits until the device has all of it buffered
+inline void writeSlaveAndWait(KPtyDevice *pty, const QByteArray &data)
+{
+    const qint64 expected = pty->bytesAvailable() + data.size();
+    writeSlave(pty, data);
+    while (pty->bytesAvailable() < expected) {
+        QVERIFY(pty->waitForReadyRead(1000));
+    }
+}
+
+#endif
@@ -0,0 +1,109 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kptythreadingbenchmark.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTest>
+#include <QThread>
+#include <QTimer>
+#include <kptydevice.h>
+#include <kptyprocess.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+static const int sessionsPerThread = 8;
+static const qint64 bytesPerSession = 4 * 1024 * 1024;
+
+// Runs a group of sessions flooding their ptys in the event loop of the
+// calling thread. Returns the amount of data read.
+static qint64 runSessions()
+{
+    QEventLoop loop;
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    QObject::connect(&timeout, &QTimer::timeout, &loop, [&loop]() {
+        loop.exit(1);
+    });
+
+    std::vector<std::unique_ptr<KPtyProcess>> sessions;
+    qint64 received = 0;
+    int complete = 0;
+    for (int i = 0; i < sessionsPerThread; ++i) {
+        auto p = std::make_unique<KPtyProcess>();
+        p->setProgram("head", QStringList() << "-c" << QString::number(bytesPerSession) << "/dev/zero");
+        p->setPtyChannels(KPtyProcess::AllChannels);
+        KPtyDevice *pty = p->pty();
+        auto sessionReceived = std::make_shared<qint64>(0);
+        QObject::connect(pty, &QIODevice::readyRead, &loop, [&, pty, sessionReceived]() {
+            const qint64 size = pty->readAll().size();
+            received += size;
+            *sessionReceived += size;
+            if (*sessionReceived == bytesPerSession && ++complete == sessionsPerThread) {
+                loop.quit();
+            }
+        });
+        p->start();
+        sessions.push_back(std::move(p));
+    }
+
+    timeout.start(60000);
+    if (loop.exec()) {
+        qWarning() << "sessions timed out";
+    }
+    for (const auto &p : sessions) {
+        p->waitForFinished();
+    }
+    return received;
+}
+
+void KPtyThreadingBenchmark::benchmark_throughput_data()
+{
+    QTest::addColumn<int>("threads");
+
+    const int ideal = qMax(1, QThread::idealThreadCount());
+    for (int threads = 1; threads < ideal; threads *= 2) {
+        QTest::addRow("%d threads", threads) << threads;
+    }
+    QTest::addRow("%d threads", ideal) << ideal;
+}
+
+// Measures the aggregate throughput of sessions spread over several
+// threads, each with its own event loop and its own ptys.
+void KPtyThreadingBenchmark::benchmark_throughput()
+{
+    QFETCH(int, threads);
+
+    std::atomic<qint64> received{0};
+    std::vector<std::unique_ptr<QThread>> workers;
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < threads; ++i) {
+        workers.emplace_back(QThread::create([&received]() {
+            received += runSessions();
+        }));
+        workers.back()->start();
+    }
+    for (const auto &worker : workers) {
+        QVERIFY(worker->wait(120000));
+    }
+    const qint64 elapsed = qMax<qint64>(1, timer.nsecsElapsed());
+
+    QCOMPARE(received.load(), threads * sessionsPerThread * bytesPerSession);
+    const qreal throughput = qreal(received.load()) * 1000000000 / elapsed;
+    qDebug() << threads << "threads," << threads * sessionsPerThread << "sessions:" << qint64(throughput / 1000000) << "MB/s";
+    QTest::setBenchmarkResult(throughput, QTest::BytesPerSecond);
+}
+
+QTEST_GUILESS_MAIN(KPtyThreadingBenchmark)
+
+#include "moc_kptythreadingbenchmark.cpp"
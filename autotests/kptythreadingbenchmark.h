@@ -0,0 +1,23 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef kptythreadingbenchmark_h
+#define kptythreadingbenchmark_h
+
+#include <QObject>
+
+class KPtyThreadingBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void benchmark_throughput_data();
+    void benchmark_throughput();
+};
+
+#endif
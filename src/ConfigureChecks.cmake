@@ -85,7 +85,11 @@ if (UNIX)
   endif (openpty_in_libc OR openpty_in_libutil)
 
   check_function_exists(ptsname    HAVE_PTSNAME)
+  check_function_exists(ptsname_r  HAVE_PTSNAME_R)
   check_function_exists(tcgetattr  HAVE_TCGETATTR)
   check_function_exists(tcsetattr  HAVE_TCSETATTR)
+
+  check_function_exists(memfd_create HAVE_MEMFD_CREATE)
+  check_include_files(sys/eventfd.h HAVE_SYS_EVENTFD_H)
 endif (UNIX)
 
@@ -6,6 +6,7 @@
 #cmakedefine01 HAVE_GRANTPT
 #cmakedefine01 HAVE_OPENPTY
 #cmakedefine01 HAVE_PTSNAME
+#cmakedefine01 HAVE_PTSNAME_R
 #cmakedefine01 HAVE_REVOKE
 #cmakedefine01 HAVE_UNLOCKPT
 #cmakedefine01 HAVE__GETPTY
@@ -22,6 +23,7 @@
 #cmakedefine01 HAVE_SYS_FILIO_H
 
 #cmakedefine01 HAVE_UTEMPTER
+#cmakedefine01 HAVE_ZSTD
 #cmakedefine01 HAVE_LOGIN
 #cmakedefine01 HAVE_UTMPX
 #cmakedefine01 HAVE_LOGINX
@@ -32,6 +34,8 @@
 #cmakedefine01 HAVE_STRUCT_UTMP_UT_ID
 
 #cmakedefine01 HAVE_SYS_TIME_H
+#cmakedefine01 HAVE_SYS_EVENTFD_H
+#cmakedefine01 HAVE_MEMFD_CREATE
 
 /*
  * Steven Schultz <sms at to.gd-es.com> tells us :
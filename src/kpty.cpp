@@ -136,6 +136,20 @@ extern "C" {
 // private functions //
 ///////////////////////
 
+#if HAVE_PTSNAME
+// ptsname() returns a static buffer, which would be shared by all threads
+static const char *slaveName(int fd, char *buf, size_t size)
+{
+#if HAVE_PTSNAME_R
+    return ptsname_r(fd, buf, size) ? nullptr : buf;
+#else
+    Q_UNUSED(buf);
+    Q_UNUSED(size);
+    return ptsname(fd);
+#endif
+}
+#endif
+
 //////////////////
 // private data //
 //////////////////
@@ -228,7 +242,8 @@ bool KPty::open()
 #endif
     if (d->masterFd >= 0) {
 #if HAVE_PTSNAME
-        char *ptsn = ptsname(d->masterFd);
+        char ptsnBuf[PATH_MAX];
+        const char *ptsn = slaveName(d->masterFd, ptsnBuf, sizeof(ptsnBuf));
         if (ptsn) {
             d->ttyName = ptsn;
 #else
@@ -339,7 +354,8 @@ bool KPty::open(int fd)
     d->ownMaster = false;
 
 #if HAVE_PTSNAME
-    char *ptsn = ptsname(fd);
+    char ptsnBuf[PATH_MAX];
+    const char *ptsn = slaveName(fd, ptsnBuf, sizeof(ptsnBuf));
     if (ptsn) {
         d->ttyName = ptsn;
 #else
@@ -422,6 +438,10 @@ void KPty::close()
         ::close(d->masterFd);
     }
     d->masterFd = -1;
+    d->termiosCached = false;
+    d->termiosUpdateDepth = 0;
+    d->rawMode = false;
+    d->winSizePending = false;
 }
 
 void KPty::setCTty()
@@ -618,14 +638,90 @@ bool KPty::tcGetAttr(struct ::termios *ttmode) const
 {
     Q_D(const KPty);
 
-    return _tcgetattr(d->masterFd, ttmode) == 0;
+    if (d->termiosUpdateDepth || (d->termiosTracked && d->termiosCached)) {
+        *ttmode = d->termios;
+        return true;
+    }
+    if (_tcgetattr(d->masterFd, ttmode)) {
+        return false;
+    }
+    d->termios = *ttmode;
+    d->termiosCached = true;
+    return true;
 }
 
 bool KPty::tcSetAttr(struct ::termios *ttmode)
 {
     Q_D(KPty);
 
-    return _tcsetattr(d->masterFd, ttmode) == 0;
+    if (d->termiosUpdateDepth) {
+        d->termios = *ttmode;
+        return true;
+    }
+    if (_tcsetattr(d->masterFd, ttmode)) {
+        d->termiosCached = false;
+        return false;
+    }
+    // the driver may not support all attributes, so the cache may be off
+    // until it is revalidated by the next tcGetAttr()
+    d->termios = *ttmode;
+    d->termiosCached = d->termiosTracked;
+    return true;
+}
+
+bool KPty::beginTermiosUpdate()
+{
+    Q_D(KPty);
+
+    if (d->termiosUpdateDepth) {
+        d->termiosUpdateDepth++;
+        return true;
+    }
+    if (!d->termiosTracked || !d->termiosCached) {
+        if (_tcgetattr(d->masterFd, &d->termios)) {
+            d->termiosCached = false;
+            return false;
+        }
+        d->termiosCached = true;
+    }
+    d->committedTermios = d->termios;
+    d->termiosUpdateDepth = 1;
+    return true;
+}
+
+bool KPty::commitTermiosUpdate()
+{
+    Q_D(KPty);
+
+    if (!d->termiosUpdateDepth) {
+        qCWarning(KPTY_LOG) << "commitTermiosUpdate() without beginTermiosUpdate()";
+        return false;
+    }
+    if (--d->termiosUpdateDepth) {
+        return true;
+    }
+
+    bool ok = true;
+    if (memcmp(&d->termios, &d->committedTermios, sizeof(d->termios))) {
+        if (_tcsetattr(d->masterFd, &d->termios)) {
+            ok = false;
+        }
+        d->termiosCached = ok && d->termiosTracked;
+    }
+    if (d->winSizePending) {
+        d->winSizePending = false;
+        if (ioctl(d->masterFd, TIOCSWINSZ, (char *)&d->pendingWinSize)) {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool KPty::isTermiosUpdateActive() const
+{
+    Q_D(const KPty);
+
+    return d->termiosUpdateDepth > 0;
 }
 
 bool KPty::setWinSize(int lines, int columns, int height, int width)
@@ -637,6 +733,11 @@ bool KPty::setWinSize(int lines, int columns, int height, int width)
     winSize.ws_col = (unsigned short)columns;
     winSize.ws_ypixel = (unsigned short)height;
     winSize.ws_xpixel = (unsigned short)width;
+    if (d->termiosUpdateDepth) {
+        d->pendingWinSize = winSize;
+        d->winSizePending = true;
+        return true;
+    }
     return ioctl(d->masterFd, TIOCSWINSZ, (char *)&winSize) == 0;
 }
 
@@ -647,16 +748,75 @@ bool KPty::setWinSize(int lines, int columns)
 
 bool KPty::setEcho(bool echo)
 {
-    struct ::termios ttmode;
-    if (!tcGetAttr(&ttmode)) {
+    if (!beginTermiosUpdate()) {
         return false;
     }
+    Q_D(KPty);
     if (!echo) {
-        ttmode.c_lflag &= ~ECHO;
+        d->termios.c_lflag &= ~ECHO;
+    } else {
+        d->termios.c_lflag |= ECHO;
+    }
+    return commitTermiosUpdate();
+}
+
+// the flags raw mode changes, like cfmakeraw(3)
+static const tcflag_t s_rawIFlags = IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON;
+static const tcflag_t s_rawOFlags = OPOST;
+static const tcflag_t s_rawLFlags = ECHO | ECHONL | ICANON | ISIG | IEXTEN;
+static const tcflag_t s_rawCFlags = CSIZE | PARENB;
+
+bool KPty::setRawMode(bool raw)
+{
+    if (!beginTermiosUpdate()) {
+        return false;
+    }
+    Q_D(KPty);
+    struct ::termios &ttmode = d->termios;
+    if (raw) {
+        if (!d->rawMode) {
+            d->cookedTermios = ttmode;
+        }
+        ttmode.c_iflag &= ~s_rawIFlags;
+        ttmode.c_oflag &= ~s_rawOFlags;
+        ttmode.c_lflag &= ~s_rawLFlags;
+        ttmode.c_cflag &= ~s_rawCFlags;
+        ttmode.c_cflag |= CS8;
+        ttmode.c_cc[VMIN] = 1;
+        ttmode.c_cc[VTIME] = 0;
+    } else if (d->rawMode) {
+        // put back exactly what raw mode changed
+        const struct ::termios &cooked = d->cookedTermios;
+        ttmode.c_iflag = (ttmode.c_iflag & ~s_rawIFlags) | (cooked.c_iflag & s_rawIFlags);
+        ttmode.c_oflag = (ttmode.c_oflag & ~s_rawOFlags) | (cooked.c_oflag & s_rawOFlags);
+        ttmode.c_lflag = (ttmode.c_lflag & ~s_rawLFlags) | (cooked.c_lflag & s_rawLFlags);
+        ttmode.c_cflag = (ttmode.c_cflag & ~s_rawCFlags) | (cooked.c_cflag & s_rawCFlags);
+        ttmode.c_cc[VMIN] = cooked.c_cc[VMIN];
+        ttmode.c_cc[VTIME] = cooked.c_cc[VTIME];
+    } else {
+        // not made raw by us, so there is nothing to go back to
+        ttmode.c_iflag |= BRKINT | ICRNL | IXON;
+        ttmode.c_oflag |= OPOST | ONLCR;
+        ttmode.c_lflag |= ECHO | ECHOE | ECHOK | ICANON | ISIG | IEXTEN;
+        ttmode.c_cflag &= ~s_rawCFlags;
+        ttmode.c_cflag |= CS8;
+    }
+    d->rawMode = raw;
+    return commitTermiosUpdate();
+}
+
+bool KPty::setFlowControlEnabled(bool enabled)
+{
+    if (!beginTermiosUpdate()) {
+        return false;
+    }
+    Q_D(KPty);
+    if (enabled) {
+        d->termios.c_iflag |= IXON | IXOFF;
     } else {
-        ttmode.c_lflag |= ECHO;
+        d->termios.c_iflag &= ~(IXON | IXOFF);
     }
-    return tcSetAttr(&ttmode);
+    return commitTermiosUpdate();
 }
 
 const char *KPty::ttyName() const
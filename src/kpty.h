@@ -24,6 +24,10 @@ struct termios;
  *
  * \brief Provides primitives for opening & closing a pseudo TTY pair, assigning the
  * controlling TTY, utmp registration and setting various terminal attributes.
+ *
+ * KPty is reentrant: different instances may be used from different
+ * threads at the same time, but a single instance must not be used from
+ * several threads concurrently.
  */
 class KPTY_EXPORT KPty
 {
@@ -158,6 +162,52 @@ public:
      */
     bool tcSetAttr(struct ::termios *ttmode);
 
+    /*!
+     * Start a batch of terminal attribute changes.
+     *
+     * The attributes are read from the pty once, after which tcGetAttr(),
+     * tcSetAttr(), setEcho(), setRawMode(), setFlowControlEnabled() and
+     * setWinSize() only operate on a working copy, until
+     * commitTermiosUpdate() applies the result with at most one
+     * tcsetattr(3) and one TIOCSWINSZ ioctl. Attributes which end up
+     * unchanged are not written at all.
+     *
+     * As the process on the slave side may change the attributes at any
+     * time, they are read anew at the start of each batch, and a single
+     * setEcho() or setRawMode() outside a batch costs a tcgetattr(3) and a
+     * tcsetattr(3) as before; batching only pays off for several changes
+     * at once. Only while changes are tracked by
+     * KPtyDevice::setTermiosTracking() is the last known state used instead
+     * of reading it again.
+     *
+     * Batches may be nested; only the outermost commit applies the
+     * changes.
+     *
+     * This function can be used only while the PTY is open.
+     *
+     * Returns true on success. On failure, no batch is started and
+     *  commitTermiosUpdate() must not be called.
+     *
+     * \since 6.28
+     */
+    bool beginTermiosUpdate();
+
+    /*!
+     * Apply the changes made since beginTermiosUpdate().
+     *
+     * Returns true on success, false otherwise
+     *
+     * \since 6.28
+     */
+    bool commitTermiosUpdate();
+
+    /*!
+     * Returns true while a batch started with beginTermiosUpdate() is open
+     *
+     * \since 6.28
+     */
+    bool isTermiosUpdateActive() const;
+
     /*!
      * Change the logical (screen) size of the pty.
      * The default is 24 lines by 80 columns in characters, and zero pixels.
@@ -200,6 +250,39 @@ public:
      */
     bool setEcho(bool echo);
 
+    /*!
+     * Set whether the pty passes input and output through unprocessed.
+     *
+     * Raw mode disables line editing, echo, signal generation, input and
+     * output translation and software flow control, like cfmakeraw(3).
+     * Leaving raw mode restores the attributes it changed to what they were
+     * before; if the pty was not put into raw mode by this function, they
+     * are turned back on with common defaults.
+     *
+     * This function can be used only while the PTY is open.
+     *
+     * \a raw true if the pty should be in raw mode.
+     *
+     * Returns true on success, false otherwise
+     *
+     * \since 6.28
+     */
+    bool setRawMode(bool raw);
+
+    /*!
+     * Set whether the pty reacts to the XON/XOFF characters (usually
+     * Ctrl-Q and Ctrl-S) in both directions.
+     *
+     * This function can be used only while the PTY is open.
+     *
+     * \a enabled true if software flow control should be enabled.
+     *
+     * Returns true on success, false otherwise
+     *
+     * \since 6.28
+     */
+    bool setFlowControlEnabled(bool enabled);
+
     /*!
      * Returns the name of the slave pty device.
      *
@@ -16,6 +16,9 @@
 #include <QByteArray>
 #include <QString>
 
+#include <sys/ioctl.h>
+#include <termios.h>
+
 class KPtyPrivate
 {
 public:
@@ -36,6 +39,18 @@ public:
 
     bool withCTty = true;
 
+    // the attributes as last read or written; outside a batch, they are
+    // only trusted while changes are tracked, see beginTermiosUpdate()
+    mutable struct ::termios termios;
+    struct ::termios committedTermios;
+    mutable bool termiosCached = false;
+    bool termiosTracked = false; // set while changes by the slave are reported
+    int termiosUpdateDepth = 0;
+    bool rawMode = false;
+    struct ::termios cookedTermios; // the attributes before setRawMode(true)
+    struct winsize pendingWinSize;
+    bool winSizePending = false;
+
     KPty *q_ptr;
 };
 
@@ -0,0 +1,219 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kptyawaitable_p.h"
+#include "kptydevice_p.h"
+
+#include <kpty_debug.h>
+
+#include <utility>
+
+//////////////////
+// private data //
+//////////////////
+
+KPtyAwaitablePrivate::KPtyAwaitablePrivate(KPtyDevice *dev, Operation op)
+    : device(dev)
+    , operation(op)
+{
+}
+
+KPtyAwaitablePrivate::~KPtyAwaitablePrivate()
+{
+    stopWaiting();
+}
+
+void KPtyAwaitablePrivate::setDelimiter(const QByteArray &delim)
+{
+    delimiter = delim;
+    if (delimiter.isEmpty()) {
+        operation = ReadSome;
+        return;
+    }
+
+    failure.resize(delimiter.size());
+    failure[0] = 0;
+    for (int i = 1, k = 0; i < delimiter.size(); ++i) {
+        while (k && delimiter[i] != delimiter[k]) {
+            k = failure[k - 1];
+        }
+        if (delimiter[i] == delimiter[k]) {
+            ++k;
+        }
+        failure[i] = k;
+    }
+}
+
+bool KPtyAwaitablePrivate::findDelimiter()
+{
+    if (matchEnd >= 0) {
+        return true;
+    }
+
+    KPtyDevicePrivate *dd = device->d_func();
+    const qint64 head = dd->readBufferHead();
+    if (scanned < head || scanned > dd->readBufferEnd) {
+        // someone else consumed data we did not see yet, or the stream was
+        // rebased by receiveSession()
+        scanned = head;
+        matched = 0;
+    }
+
+    dd->readBuffer.forEachChunk(int(scanned - head), [this](const char *data, int size) {
+        for (int i = 0; i < size; ++i) {
+            while (matched && data[i] != delimiter[matched]) {
+                matched = failure[matched - 1];
+            }
+            if (data[i] == delimiter[matched]) {
+                ++matched;
+            }
+            if (matched == delimiter.size()) {
+                scanned += i + 1;
+                matchEnd = scanned;
+                return false;
+            }
+        }
+        scanned += size;
+        return true;
+    });
+    return matchEnd >= 0;
+}
+
+qint64 KPtyAwaitablePrivate::takeMatch()
+{
+    const qint64 size = matchEnd - device->d_func()->readBufferHead();
+    matchEnd = -1;
+    return size;
+}
+
+bool KPtyAwaitablePrivate::isReady()
+{
+    if (!device || !device->isOpen()) {
+        return true;
+    }
+
+    KPtyDevicePrivate *dd = device->d_func();
+    if (operation != Drain && dd->readSinkAcquire) {
+        // the data goes to the sink, so waiting for it would never end
+        qCWarning(KPTY_LOG) << "Reads can't be awaited while a read sink is set";
+        return true;
+    }
+    switch (operation) {
+    case ReadSome:
+        return dd->eof || device->bytesAvailable() > 0;
+    case ReadLine:
+        return dd->eof || device->canReadLine();
+    case ReadUntil:
+        return dd->eof || findDelimiter();
+    case Drain:
+        return !device->bytesToWrite();
+    }
+    return true;
+}
+
+void KPtyAwaitablePrivate::check()
+{
+    if (handle && isReady()) {
+        stopWaiting();
+        std::exchange(handle, {}).resume();
+    }
+}
+
+void KPtyAwaitablePrivate::wait(std::coroutine_handle<> h)
+{
+    handle = h;
+
+    KPtyDevice *dev = device;
+    auto checker = [this]() {
+        check();
+    };
+    if (operation == Drain) {
+        connections << QObject::connect(dev, &QIODevice::bytesWritten, dev, checker);
+    } else {
+        connections << QObject::connect(dev, &QIODevice::readyRead, dev, checker);
+        connections << QObject::connect(dev, &KPtyDevice::readEof, dev, checker);
+    }
+    // the device is still open while this is emitted, so the coroutine is
+    // resumed only after it was closed
+    connections << QObject::connect(dev, &QIODevice::aboutToClose, dev, [this]() {
+        QMetaObject::invokeMethod(
+            &context,
+            [this]() {
+                check();
+            },
+            Qt::QueuedConnection);
+    });
+    // not bound to the device, as it is gone by the time this is delivered
+    connections << QObject::connect(dev, &QObject::destroyed, [this]() {
+        stopWaiting();
+        device = nullptr;
+        std::exchange(handle, {}).resume();
+    });
+}
+
+void KPtyAwaitablePrivate::stopWaiting()
+{
+    for (const auto &connection : std::as_const(connections)) {
+        QObject::disconnect(connection);
+    }
+    connections.clear();
+}
+
+/////////////////////////////
+// public member functions //
+/////////////////////////////
+
+KPtyAwaitable::KPtyAwaitable(std::unique_ptr<KPtyAwaitablePrivate> d)
+    : d_ptr(std::move(d))
+{
+}
+
+KPtyAwaitable::KPtyAwaitable(KPtyAwaitable &&other) noexcept = default;
+
+KPtyAwaitable &KPtyAwaitable::operator=(KPtyAwaitable &&other) noexcept = default;
+
+KPtyAwaitable::~KPtyAwaitable()
+{
+}
+
+bool KPtyAwaitable::await_ready()
+{
+    Q_D(KPtyAwaitable);
+    return d->isReady();
+}
+
+void KPtyAwaitable::await_suspend(std::coroutine_handle<> handle)
+{
+    Q_D(KPtyAwaitable);
+    d->wait(handle);
+}
+
+QByteArray KPtyAwaitable::await_resume()
+{
+    Q_D(KPtyAwaitable);
+
+    KPtyDevice *device = d->device;
+    if (!device || !device->isOpen()) {
+        return QByteArray();
+    }
+
+    switch (d->operation) {
+    case KPtyAwaitablePrivate::ReadSome:
+        return device->read(d->maxSize > 0 ? d->maxSize : device->bytesAvailable());
+    case KPtyAwaitablePrivate::ReadLine:
+        return device->canReadLine() ? device->readLine() : device->readAll();
+    case KPtyAwaitablePrivate::ReadUntil:
+        if (d->findDelimiter()) {
+            const qint64 size = d->takeMatch();
+            return size > 0 ? device->read(size) : QByteArray();
+        }
+        return device->readAll();
+    case KPtyAwaitablePrivate::Drain:
+        break;
+    }
+    return QByteArray();
+}
@@ -0,0 +1,102 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef kptyawaitable_h
+#define kptyawaitable_h
+
+#include "kpty_export.h"
+
+#include <QByteArray>
+
+#include <coroutine>
+#include <memory>
+
+class KPtyAwaitablePrivate;
+class KPtyDevice;
+
+/*!
+ * \class KPtyAwaitable
+ * \inmodule KPty
+ *
+ * \brief An operation on a KPtyDevice which can be awaited in a C++20
+ * coroutine.
+ *
+ * Awaitables are obtained from KPtyDevice::readSomeAsync(),
+ * KPtyDevice::readLineAsync(), KPtyDevice::readUntilAsync() and
+ * KPtyDevice::drainAsync(), and are meant to be awaited right away:
+ *
+ * \code
+ * QByteArray prompt = co_await pty->readUntilAsync("login: ");
+ * pty->write("user\n");
+ * co_await pty->drainAsync();
+ * \endcode
+ *
+ * If the operation can't complete immediately, the coroutine is
+ * suspended and resumed from within the signal of the device which
+ * completes it (readyRead(), readEof() or bytesWritten()). No thread is
+ * blocked meanwhile, so any number of coroutines can wait on different
+ * devices in the same event loop. As with a slot connected to these
+ * signals, the resumed coroutine must not delete the device directly;
+ * use deleteLater().
+ *
+ * When the device is closed or destroyed, the coroutine is resumed with
+ * whatever result is available at that point; the device is no longer
+ * open by then.
+ *
+ * While a read sink is set, see KPtyDevice::setReadSink(), the data never
+ * reaches the read buffer. Awaiting a read then completes right away with
+ * the data which is still buffered, if any, and a warning. Setting a sink
+ * while a read is awaited leaves the coroutine suspended until the device
+ * is closed.
+ *
+ * KPty does not provide a coroutine type; any type whose promise does
+ * not transform awaited expressions will do.
+ *
+ * \since 6.28
+ */
+class KPTY_EXPORT KPtyAwaitable
+{
+    Q_DECLARE_PRIVATE(KPtyAwaitable)
+
+public:
+    /*!
+     * \internal
+     */
+    explicit KPtyAwaitable(std::unique_ptr<KPtyAwaitablePrivate> d);
+
+    KPtyAwaitable(KPtyAwaitable &&other) noexcept;
+    KPtyAwaitable &operator=(KPtyAwaitable &&other) noexcept;
+
+    /*!
+     * Destructor:
+     *
+     * Stops waiting, without resuming the coroutine.
+     */
+    ~KPtyAwaitable();
+
+    /*!
+     * Returns true if the operation can complete without suspending
+     */
+    bool await_ready();
+
+    /*!
+     * Suspends the coroutine \a handle until the operation can complete.
+     */
+    void await_suspend(std::coroutine_handle<> handle);
+
+    /*!
+     * Completes the operation.
+     *
+     * Returns the data read, or an empty array for drainAsync()
+     */
+    QByteArray await_resume();
+
+private:
+    std::unique_ptr<KPtyAwaitablePrivate> d_ptr;
+};
+
+#endif
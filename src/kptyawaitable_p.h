@@ -0,0 +1,55 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef kptyawaitable_p_h
+#define kptyawaitable_p_h
+
+#include "kptyawaitable.h"
+#include "kptydevice.h"
+
+#include <QList>
+#include <QObject>
+#include <QPointer>
+
+class KPtyAwaitablePrivate
+{
+public:
+    enum Operation {
+        ReadSome,
+        ReadLine,
+        ReadUntil,
+        Drain,
+    };
+
+    KPtyAwaitablePrivate(KPtyDevice *dev, Operation op);
+    ~KPtyAwaitablePrivate();
+
+    void setDelimiter(const QByteArray &delim);
+    bool isReady();
+    bool findDelimiter();
+    qint64 takeMatch();
+    void wait(std::coroutine_handle<> handle);
+    void stopWaiting();
+    void check();
+
+    QPointer<KPtyDevice> device;
+    Operation operation;
+    qint64 maxSize = 0;
+
+    // incremental Knuth-Morris-Pratt search for the delimiter
+    QByteArray delimiter;
+    QList<int> failure;
+    int matched = 0;
+    qint64 scanned = 0; // stream offset up to which the read buffer was searched
+    qint64 matchEnd = -1;
+
+    std::coroutine_handle<> handle;
+    QList<QMetaObject::Connection> connections;
+    QObject context; // for queued calls, which must not outlive this
+};
+
+#endif
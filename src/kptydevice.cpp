@@ -7,311 +7,648 @@
     SPDX-License-Identifier: LGPL-2.0-or-later
 */
 
-#include "kptydevice.h"
-#include "kpty_p.h"
+#include "kptyawaitable_p.h"
+#include "kptydevice_p.h"
+#include "kptyexpect_p.h"
+#include "kptyhistory.h"
+#include "kptyreadscheduler_p.h"
+#include "kptyretentionbuffer.h"
+#include "kptysubscription_p.h"
 
 #include <config-pty.h>
+#include <kpty_debug.h>
 
+#include <QFile>
+#include <QPointer>
 #include <QSocketNotifier>
+#include <QTimer>
 
 #include <KLocalizedString>
 
 #include <cerrno>
 #include <fcntl.h>
+#include <poll.h>
 #include <signal.h>
-#include <sys/ioctl.h>
 #include <termios.h>
 #include <unistd.h>
-#if HAVE_SYS_FILIO_H
-#include <sys/filio.h>
-#endif
-#if HAVE_SYS_TIME_H
-#include <sys/time.h>
-#endif
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <utility>
 
-#if defined(Q_OS_FREEBSD) || defined(Q_OS_MAC)
-// "the other end's output queue size" -- that is is our end's input
-#define PTY_BYTES_AVAILABLE TIOCOUTQ
-#elif defined(TIOCINQ)
-// "our end's input queue size"
-#define PTY_BYTES_AVAILABLE TIOCINQ
-#else
-// likewise. more generic ioctl (theoretically)
-#define PTY_BYTES_AVAILABLE FIONREAD
-#endif
+//////////////////
+// private data //
+//////////////////
+
+// Lifted from Qt. I don't think they would mind. ;)
+// Re-lift again from Qt whenever a proper replacement for pthread_once appears
+static void qt_ignore_sigpipe()
+{
+    static QBasicAtomicInt atom = Q_BASIC_ATOMIC_INITIALIZER(0);
+    if (atom.testAndSetRelaxed(0, 1)) {
+        struct sigaction noaction;
+        memset(&noaction, 0, sizeof(noaction));
+        noaction.sa_handler = SIG_IGN;
+        sigaction(SIGPIPE, &noaction, nullptr);
+    }
+}
+
+/* clang-format off */
+#define NO_INTR(ret, func) \
+    do { \
+        ret = func; \
+    } while (ret < 0 && errno == EINTR)
+/* clang-format on */
 
-#define KMAXINT ((int)(~0U >> 1))
+// session handoff, see KPtyDevice::sendSession()
+#define KPTY_SESSION_MAGIC 0x4b505453 // "KPTS"
+#define KPTY_SESSION_VERSION 1
 
-/////////////////////////////////////////////////////
-// Helper. Remove when QRingBuffer becomes public. //
-/////////////////////////////////////////////////////
+enum KPtySessionFlag {
+    SessionPacketMode = 1,
+    SessionOutputSuspended = 2,
+    SessionTermiosTracked = 4,
+};
 
-#include <QByteArray>
-#include <QList>
+// Followed by readSize bytes of read data and writeSize bytes of data to
+// write. The master fd travels with the first byte.
+struct KPtySessionHeader {
+    quint32 magic;
+    quint32 version;
+    quint32 size; // guards against mismatched builds
+    quint32 flags;
+    qint64 streamOffset; // of the read data
+    qint64 readSize;
+    qint64 writeSize;
+    struct ::termios termios;
+    struct winsize winSize;
+};
 
-#define CHUNKSIZE 4096
+static bool waitForSocket(int socket, short events, const QDeadlineTimer &deadline)
+{
+    struct pollfd pfd = {socket, events, 0};
+    int ret;
+    NO_INTR(ret, poll(&pfd, 1, deadline.isForever() ? -1 : int(qMin<qint64>(deadline.remainingTime(), KMAXINT))));
+    return ret > 0;
+}
 
-class KRingBuffer
+static bool sendAll(int socket, const char *data, qint64 size, const QDeadlineTimer &deadline)
 {
-public:
-    KRingBuffer()
-    {
-        clear();
+    while (size > 0) {
+        const ssize_t sent = ::send(socket, data, size, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if ((errno != EAGAIN && errno != EWOULDBLOCK) || !waitForSocket(socket, POLLOUT, deadline)) {
+                return false;
+            }
+            continue;
+        }
+        data += sent;
+        size -= sent;
     }
+    return true;
+}
 
-    void clear()
-    {
-        buffers.clear();
-        QByteArray tmp;
-        tmp.resize(CHUNKSIZE);
-        buffers << tmp;
-        head = tail = 0;
-        totalSize = 0;
+static bool receiveAll(int socket, char *data, qint64 size, const QDeadlineTimer &deadline)
+{
+    while (size > 0) {
+        const ssize_t received = ::recv(socket, data, size, 0);
+        if (received < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if ((errno != EAGAIN && errno != EWOULDBLOCK) || !waitForSocket(socket, POLLIN, deadline)) {
+                return false;
+            }
+            continue;
+        }
+        if (!received) {
+            return false;
+        }
+        data += received;
+        size -= received;
     }
+    return true;
+}
 
-    inline bool isEmpty() const
-    {
-        return buffers.count() == 1 && !tail;
+void KPtyDevicePrivate::updateReadNotifier()
+{
+    if (readNotifier) {
+        readNotifier->setEnabled(!suspended && !eof && !throttled && !readersLagging() && !scheduled);
     }
+}
 
-    inline int size() const
-    {
-        return totalSize;
+qint64 KPtyDevicePrivate::availableTokens()
+{
+    const qint64 elapsed = tokenClock.restart();
+    tokens = qMin<double>(readBurst, tokens + double(elapsed) * readRateLimit / 1000);
+    return qint64(tokens);
+}
+
+void KPtyDevicePrivate::throttle(qint64 wanted)
+{
+    Q_Q(KPtyDevice);
+
+    // sleep until the bucket holds enough tokens for the pending data,
+    // leaving it to the kernel to push back on the writer meanwhile
+    const qint64 delay = qMax<qint64>(1, qint64((qMin(wanted, readBurst) - tokens) * 1000 / readRateLimit) + 1);
+    throttled = true;
+    throttleDeadline.setRemainingTime(delay, Qt::PreciseTimer);
+    throttleClock.start();
+    stats.throttleCount++;
+    updateReadNotifier();
+
+    if (!throttleTimer) {
+        throttleTimer = new QTimer(q);
+        throttleTimer->setSingleShot(true);
+        throttleTimer->setTimerType(Qt::PreciseTimer);
+        QObject::connect(throttleTimer, &QTimer::timeout, q, [this]() {
+            unthrottle();
+        });
     }
+    throttleTimer->start(delay);
+}
 
-    inline int readSize() const
-    {
-        return (buffers.count() == 1 ? tail : buffers.first().size()) - head;
+void KPtyDevicePrivate::unthrottle()
+{
+    if (!throttled) {
+        return;
     }
+    throttled = false;
+    stats.throttledTime += throttleClock.elapsed();
+    throttleTimer->stop();
+    updateReadNotifier();
+}
+
+void KPtyDevicePrivate::startWinSizeTimer(QTimer *&timer, int msecs)
+{
+    Q_Q(KPtyDevice);
 
-    inline const char *readPointer() const
-    {
-        Q_ASSERT(totalSize > 0);
-        return buffers.first().constData() + head;
+    if (!timer) {
+        timer = new QTimer(q);
+        timer->setSingleShot(true);
+        QObject::connect(timer, &QTimer::timeout, q, [q]() {
+            q->flushWinSize();
+        });
     }
+    timer->start(msecs);
+}
 
-    void free(int bytes)
-    {
-        totalSize -= bytes;
-        Q_ASSERT(totalSize >= 0);
+static QString processName(qint64 pid)
+{
+#ifdef Q_OS_LINUX
+    QFile comm(QStringLiteral("/proc/%1/comm").arg(pid));
+    if (comm.open(QIODevice::ReadOnly)) {
+        return QString::fromLocal8Bit(comm.readAll()).trimmed();
+    }
+#else
+    Q_UNUSED(pid);
+#endif
+    return QString();
+}
 
-        for (;;) {
-            int nbs = readSize();
+void KPtyDevicePrivate::foregroundMayHaveChanged()
+{
+    Q_Q(KPtyDevice);
 
-            if (bytes < nbs) {
-                head += bytes;
-                if (head == tail && buffers.count() == 1) {
-                    buffers.first().resize(CHUNKSIZE);
-                    head = tail = 0;
-                }
-                break;
-            }
+    // checks are not postponed by further events, so a steady stream of
+    // output still gets one check per delay
+    if (foregroundCheckDelay < 0 || (foregroundTimer && foregroundTimer->isActive())) {
+        return;
+    }
+    if (!foregroundTimer) {
+        foregroundTimer = new QTimer(q);
+        foregroundTimer->setSingleShot(true);
+        QObject::connect(foregroundTimer, &QTimer::timeout, q, [this]() {
+            updateForegroundProcess(true);
+        });
+    }
+    foregroundTimer->start(foregroundCheckDelay);
+}
 
-            bytes -= nbs;
-            if (buffers.count() == 1) {
-                buffers.first().resize(CHUNKSIZE);
-                head = tail = 0;
-                break;
-            }
+void KPtyDevicePrivate::updateForegroundProcess(bool notify)
+{
+    Q_Q(KPtyDevice);
 
-            buffers.removeFirst();
-            head = 0;
-        }
+    // the master reports the foreground process group of the slave side
+    const pid_t pgrp = masterFd >= 0 ? tcgetpgrp(masterFd) : -1;
+    const qint64 pid = pgrp > 0 ? pgrp : -1;
+    if (pid == foregroundPid) {
+        return;
     }
+    foregroundPid = pid;
+    foregroundName = pid > 0 ? processName(pid) : QString();
+    if (notify) {
+        Q_EMIT q->foregroundProcessChanged(foregroundPid, foregroundName);
+    }
+}
 
-    char *reserve(int bytes)
-    {
-        totalSize += bytes;
+bool KPtyDevicePrivate::_k_canRead(int limit)
+{
+    Q_Q(KPtyDevice);
+    qint64 readBytes = 0;
+    QSpan<char> sinkSpan;
 
+    int available;
+    if (!::ioctl(q->masterFd(), PTY_BYTES_AVAILABLE, (char *)&available)) {
+        if (readRateLimit > 0 && available > 0) {
+            const qint64 budget = availableTokens();
+            if (budget <= 0) {
+                throttle(available);
+                return false;
+            }
+            available = int(qMin<qint64>(available, budget));
+        }
+        // larger reads would need chunks outside the size classes
+        available = qMin(available, qMin(limit, readChunkMaximum));
+        if (sharedRing && available > 0) {
+            const qint64 space = sharedRing->freeSpace();
+            if (!space) {
+                checkSharedRingSpace();
+                return false;
+            }
+            available = int(qMin<qint64>(available, space));
+        }
         char *ptr;
-        if (tail + bytes <= buffers.last().size()) {
-            ptr = buffers.last().data() + tail;
-            tail += bytes;
+        if (readSinkAcquire) {
+            // the consumer provides the memory
+            if (available > 0) {
+                sinkSpan = readSinkAcquire(available);
+                if (sinkSpan.isEmpty()) {
+                    // the consumer may delete the device when committing
+                    suspended = true;
+                    updateReadNotifier();
+                    readSinkCommit(sinkSpan);
+                    return false;
+                }
+                available = int(qMin<qsizetype>(available, sinkSpan.size()));
+            }
+            ptr = sinkSpan.data();
         } else {
-            buffers.last().resize(tail);
-            QByteArray tmp;
-            tmp.resize(qMax(CHUNKSIZE, bytes));
-            ptr = tmp.data();
-            buffers << tmp;
-            tail = bytes;
+            adaptReadChunkSize(available);
+            ptr = readBuffer.reserve(available);
+        }
+        // give back what was not filled
+        auto release = [&](int filled) {
+            if (readSinkAcquire) {
+                if (!sinkSpan.isEmpty()) {
+                    readSinkCommit(sinkSpan.first(filled));
+                }
+            } else {
+                readBuffer.unreserve(available - filled);
+            }
+        };
+#ifdef TIOCPKT
+        if (packetMode) {
+            // the status byte preceding the data is read separately, so
+            // the data lands in the buffer as usual
+            char status;
+            struct iovec iov[2] = {{&status, 1}, {ptr, size_t(available)}};
+            NO_INTR(readBytes, readv(q->masterFd(), iov, 2));
+            if (readBytes > 0) {
+                readBytes--;
+                if (status != TIOCPKT_DATA) {
+                    // control packets carry no data
+                    QPointer<KPtyDevice> guard(q);
+                    release(0);
+                    if (guard) {
+                        handlePacket(status);
+                    }
+                    return false;
+                }
+            } else if (readBytes < 0 && errno == EIO) {
+                readBytes = 0; // the slave side was closed
+            } else if (readBytes < 0 && errno == EAGAIN) {
+                release(0);
+                return false;
+            }
+        } else
+#endif
+        {
+            NO_INTR(readBytes, read(q->masterFd(), ptr, available));
+        }
+        if (readBytes < 0) {
+            q->setErrorString(i18n("Error reading from PTY"));
+            release(0);
+            return false;
+        }
+        if (!readSinkAcquire) {
+            readBuffer.unreserve(available - readBytes); // *should* be a no-op
+        }
+        if (readBytes > 0) {
+            noteActivity();
+            stats.bytesRead += readBytes;
+            readBufferEnd += readBytes;
+            if (readRateLimit > 0) {
+                tokens -= readBytes;
+            }
+            if (history) {
+                history->append(ptr, readBytes);
+            }
+            if (retentionBuffer) {
+                retentionBuffer->append(ptr, readBytes);
+            }
+            if (tokenizer && !readSinkAcquire) {
+                tokenizer->prune(readBufferHead());
+                tokenizer->feed(ptr, readBytes, readBufferEnd - readBytes);
+            }
+            if (readSinkAcquire) {
+                if (!subscriptions.isEmpty()) {
+                    // stored for the subscriptions only, unless the device
+                    // has older data to read yet, which has to come first
+                    readBuffer.write(ptr, readBytes);
+                    if (readBuffer.size() == readBytes) {
+                        readBuffer.free(readBytes);
+                    }
+                }
+            } else if (!q->isReadable()) {
+                // nobody reads the device itself
+                readBuffer.free(readBuffer.size());
+            }
+            if (sharedRing) {
+                sharedRing->write(ptr, readBytes);
+                if (!sharedRing->freeSpace()) {
+                    checkSharedRingSpace();
+                }
+            }
         }
-        return ptr;
     }
 
-    // release a trailing part of the last reservation
-    inline void unreserve(int bytes)
-    {
-        totalSize -= bytes;
-        tail -= bytes;
+    if (readBytes > 0 && !expects.isEmpty() && !readSinkAcquire) {
+        // matchers may stop or be deleted when reporting a match
+        const QList<KPtyExpectPrivate *> matchers = expects;
+        for (KPtyExpectPrivate *expect : matchers) {
+            if (expects.contains(expect)) {
+                expect->scan();
+            }
+        }
     }
 
-    inline void write(const char *data, int len)
-    {
-        memcpy(reserve(len), data, len);
+    if (readBytes > 0 && !subscriptions.isEmpty()) {
+        feedSubscriptions();
     }
 
-    // Find the first occurrence of c and return the index after it.
-    // If c is not found until maxLength, maxLength is returned, provided
-    // it is smaller than the buffer size. Otherwise -1 is returned.
-    int indexAfter(char c, int maxLength = KMAXINT) const
-    {
-        int index = 0;
-        int start = head;
-        QList<QByteArray>::ConstIterator it = buffers.begin();
-        for (;;) {
-            if (!maxLength) {
-                return index;
-            }
-            if (index == size()) {
-                return -1;
-            }
-            const QByteArray &buf = *it;
-            ++it;
-            int len = qMin((it == buffers.end() ? tail : buf.size()) - start, maxLength);
-            const char *ptr = buf.data() + start;
-            if (const char *rptr = (const char *)memchr(ptr, c, len)) {
-                return index + (rptr - ptr) + 1;
+    // a new job usually announces itself with output, and so does the
+    // shell when it takes over again
+    foregroundMayHaveChanged();
+
+    if (!readBytes) {
+        eof = true;
+        if (sharedRing) {
+            sharedRing->finish();
+        }
+        updateReadNotifier();
+        if (!sinkSpan.isEmpty()) {
+            QPointer<KPtyDevice> guard(q);
+            readSinkCommit(sinkSpan.first(0));
+            if (!guard) {
+                return false;
             }
-            index += len;
-            maxLength -= len;
-            start = 0;
         }
+        Q_EMIT q->readEof();
+        return false;
+    } else if (readSinkAcquire) {
+        // last, as the consumer may reuse the memory, or delete the device
+        readSinkCommit(sinkSpan.first(readBytes));
+        return true;
+    } else {
+        if (!emittedReadyRead) {
+            emittedReadyRead = true;
+            Q_EMIT q->readyRead();
+            emittedReadyRead = false;
+        }
+        return true;
     }
+}
 
-    inline int lineSize(int maxLength = KMAXINT) const
-    {
-        return indexAfter('\n', maxLength);
+int KPtyDevicePrivate::completeUtf8Size(int maxSize) const
+{
+    const int size = qMin(readBuffer.size(), maxSize);
+    if (!size || (eof && size == readBuffer.size())) {
+        return size;
     }
 
-    inline bool canReadLine() const
-    {
-        return lineSize() != -1;
-    }
+    // only the last three bytes can belong to an incomplete sequence
+    const int from = qMax(0, size - 3);
+    uchar tail[3];
+    int tailSize = 0;
+    readBuffer.forEachChunk(from, [&](const char *data, int len) {
+        while (len-- && from + tailSize < size) {
+            tail[tailSize++] = uchar(*data++);
+        }
+        return from + tailSize < size;
+    });
 
-    int read(char *data, int maxLength)
-    {
-        int bytesToRead = qMin(size(), maxLength);
-        int readSoFar = 0;
-        while (readSoFar < bytesToRead) {
-            const char *ptr = readPointer();
-            int bs = qMin(bytesToRead - readSoFar, readSize());
-            memcpy(data + readSoFar, ptr, bs);
-            readSoFar += bs;
-            free(bs);
+    for (int i = tailSize - 1; i >= 0; --i) {
+        const uchar c = tail[i];
+        if ((c & 0xc0) == 0x80) {
+            continue; // a continuation byte
+        }
+        // overlong and out of range lead bytes never complete
+        const int length = c >= 0xf0 ? 4 : c >= 0xe0 ? 3 : c >= 0xc0 ? 2 : 1;
+        if (c >= 0xc2 && c <= 0xf4 && length > tailSize - i) {
+            return from + i;
         }
-        return readSoFar;
+        break;
     }
+    return size;
+}
 
-    int readLine(char *data, int maxLength)
-    {
-        return read(data, lineSize(qMin(maxLength, size())));
+void KPtyDevicePrivate::trimFanout()
+{
+    // only subscriptions behind the device need the retained data
+    qint64 oldest = readBufferHead();
+    bool block = false;
+    for (const KPtySubscriptionPrivate *subscription : std::as_const(subscriptions)) {
+        oldest = qMin(oldest, subscription->cursor);
+        if (subscription->lagPolicy == KPtySubscription::SuspendReading && subscription->lagLimit > 0
+            && subscription->lag() >= subscription->lagLimit) {
+            block = true;
+        }
     }
+    readBuffer.release(int(qMax<qint64>(0, oldest - retainedHead())));
 
-private:
-    QList<QByteArray> buffers;
-    int head, tail;
-    int totalSize;
-};
+    if (block != fanoutBlocked) {
+        fanoutBlocked = block;
+        updateReadNotifier();
+    }
+}
 
-//////////////////
-// private data //
-//////////////////
+void KPtyDevicePrivate::feedSubscriptions()
+{
+    // subscriptions may be deleted when notified
+    const QList<KPtySubscriptionPrivate *> readers = subscriptions;
+    for (KPtySubscriptionPrivate *subscription : readers) {
+        if (subscriptions.contains(subscription)) {
+            subscription->feed();
+        }
+    }
+    trimFanout();
+}
 
-// Lifted from Qt. I don't think they would mind. ;)
-// Re-lift again from Qt whenever a proper replacement for pthread_once appears
-static void qt_ignore_sigpipe()
+void KPtyDevicePrivate::rebaseStream(qint64 offset)
 {
-    static QBasicAtomicInt atom = Q_BASIC_ATOMIC_INITIALIZER(0);
-    if (atom.testAndSetRelaxed(0, 1)) {
-        struct sigaction noaction;
-        memset(&noaction, 0, sizeof(noaction));
-        noaction.sa_handler = SIG_IGN;
-        sigaction(SIGPIPE, &noaction, nullptr);
+    Q_ASSERT(readBuffer.isEmpty());
+
+    // the retained output moves along, so subscriptions still read what
+    // they did not read yet, followed by the new output
+    const qint64 delta = offset - readBufferEnd;
+    readBufferEnd = offset;
+    for (KPtySubscriptionPrivate *subscription : std::as_const(subscriptions)) {
+        subscription->cursor += delta;
+    }
+    for (KPtyExpectPrivate *expect : std::as_const(expects)) {
+        expect->scanned += delta;
+        expect->regexStart += delta;
+        expect->decodedEnd += delta;
     }
 }
 
-/* clang-format off */
-#define NO_INTR(ret, func) \
-    do { \
-        ret = func; \
-    } while (ret < 0 && errno == EINTR)
-/* clang-format on */
+void KPtyDevicePrivate::discardReadBuffer()
+{
+    // subscriptions still get what they did not read
+    readBuffer.free(readBuffer.size());
+    trimFanout();
+}
 
-class KPtyDevicePrivate : public KPtyPrivate
+void KPtyDevicePrivate::checkSharedRingSpace()
 {
-    Q_DECLARE_PUBLIC(KPtyDevice)
-public:
-    KPtyDevicePrivate(KPty *parent)
-        : KPtyPrivate(parent)
-        , emittedReadyRead(false)
-        , emittedBytesWritten(false)
-        , readNotifier(nullptr)
-        , writeNotifier(nullptr)
-    {
+    // the reader signals once it made room after we announced to wait
+    sharedRing->acknowledgeSpace();
+    const bool block = !sharedRing->waitForSpace();
+    sharedRingNotifier->setEnabled(block);
+    if (block != sharedRingBlocked) {
+        sharedRingBlocked = block;
+        updateReadNotifier();
     }
+}
 
-    bool _k_canRead();
-    bool _k_canWrite();
-
-    bool doWait(int msecs, bool reading);
-    void finishOpen(QIODevice::OpenMode mode);
+#ifdef TIOCPKT
+void KPtyDevicePrivate::handlePacket(int status)
+{
+    Q_Q(KPtyDevice);
 
-    bool emittedReadyRead;
-    bool emittedBytesWritten;
-    QSocketNotifier *readNotifier;
-    QSocketNotifier *writeNotifier;
-    KRingBuffer readBuffer;
-    KRingBuffer writeBuffer;
-};
+    if (status & TIOCPKT_FLUSHREAD) {
+        Q_EMIT q->inputFlushed();
+    }
+    if (status & TIOCPKT_FLUSHWRITE) {
+        Q_EMIT q->outputFlushed();
+    }
+    if (status & TIOCPKT_STOP) {
+        outputSuspended = true;
+        Q_EMIT q->outputSuspended();
+    }
+    if (status & TIOCPKT_START) {
+        outputSuspended = false;
+        Q_EMIT q->outputResumed();
+    }
+    if (status & TIOCPKT_DOSTOP) {
+        Q_EMIT q->flowControlChanged(true);
+    }
+    if (status & TIOCPKT_NOSTOP) {
+        Q_EMIT q->flowControlChanged(false);
+    }
+#ifdef TIOCPKT_IOCTL
+    if (status & TIOCPKT_IOCTL) {
+        // shells switch the attributes along with the foreground job
+        foregroundMayHaveChanged();
+        // changes made through KPty are already in the cache
+        struct ::termios ttmode;
+        if (!tcgetattr(masterFd, &ttmode) && (!termiosCached || memcmp(&ttmode, &termios, sizeof(ttmode)))) {
+            termios = ttmode;
+            termiosCached = true;
+            Q_EMIT q->termiosChanged(ttmode);
+        }
+    }
+#endif
+}
+#endif
 
-bool KPtyDevicePrivate::_k_canRead()
+void KPtyDevicePrivate::enableWriteNotifier()
 {
     Q_Q(KPtyDevice);
-    qint64 readBytes = 0;
 
-    int available;
-    if (!::ioctl(q->masterFd(), PTY_BYTES_AVAILABLE, (char *)&available)) {
-        char *ptr = readBuffer.reserve(available);
-        NO_INTR(readBytes, read(q->masterFd(), ptr, available));
-        if (readBytes < 0) {
-            readBuffer.unreserve(available);
-            q->setErrorString(i18n("Error reading from PTY"));
-            return false;
-        }
-        readBuffer.unreserve(available - readBytes); // *should* be a no-op
+    if (!writeNotifier) {
+        writeNotifier = new QSocketNotifier(q->masterFd(), QSocketNotifier::Write, q);
+        QObject::connect(writeNotifier, &QSocketNotifier::activated, q, [this]() {
+            _k_canWrite();
+        });
     }
+    writeNotifier->setEnabled(true);
+}
 
-    if (!readBytes) {
-        readNotifier->setEnabled(false);
-        Q_EMIT q->readEof();
-        return false;
-    } else {
-        if (!emittedReadyRead) {
-            emittedReadyRead = true;
-            Q_EMIT q->readyRead();
-            emittedReadyRead = false;
+void KPtyDevicePrivate::noteActivity()
+{
+    activeSinceIdleCheck = true;
+    if (idleTimer && !idleTimer->isActive()) {
+        idleTimer->start();
+    }
+}
+
+void KPtyDevicePrivate::checkIdle()
+{
+    if (activeSinceIdleCheck) {
+        activeSinceIdleCheck = false;
+        return;
+    }
+    idleTimer->stop();
+
+    setReadChunkSize(readChunkMinimum);
+    smallReads = 0;
+    // unconsumed data stays where it is
+    readBuffer.squeeze();
+    writeBuffer.squeeze();
+    urgentBuffer.squeeze();
+    if (writeNotifier && !hasPendingWrites()) {
+        delete writeNotifier;
+        writeNotifier = nullptr;
+    }
+}
+
+void KPtyDevicePrivate::adaptReadChunkSize(int wanted)
+{
+    const int current = readBuffer.currentChunkSize();
+    if (wanted > current) {
+        // bursts get a chunk of their own right away
+        setReadChunkSize(qMin(chunkSizeClass(wanted), readChunkMaximum));
+        smallReads = 0;
+    } else if (wanted <= current / 4 && current > readChunkMinimum) {
+        // but shrinking waits for the burst to be over
+        if (++smallReads >= 16) {
+            setReadChunkSize(current / 2);
+            smallReads = 0;
         }
-        return true;
+    } else {
+        smallReads = 0;
     }
 }
 
+void KPtyDevicePrivate::setReadChunkSize(int size)
+{
+    readBuffer.setChunkSize(size);
+}
+
 bool KPtyDevicePrivate::_k_canWrite()
 {
     Q_Q(KPtyDevice);
 
-    writeNotifier->setEnabled(false);
-    if (writeBuffer.isEmpty()) {
+    if (writeNotifier) {
+        writeNotifier->setEnabled(false);
+    }
+    KRingBuffer &buffer = urgentBuffer.isEmpty() ? writeBuffer : urgentBuffer;
+    if (buffer.isEmpty()) {
         return false;
     }
 
-    qt_ignore_sigpipe();
     int wroteBytes;
-    NO_INTR(wroteBytes, write(q->masterFd(), writeBuffer.readPointer(), writeBuffer.readSize()));
+    NO_INTR(wroteBytes, write(q->masterFd(), buffer.readPointer(), buffer.readSize()));
     if (wroteBytes < 0) {
         q->setErrorString(i18n("Error writing to PTY"));
         return false;
     }
-    writeBuffer.free(wroteBytes);
+    buffer.free(wroteBytes);
+    stats.bytesWritten += wroteBytes;
 
     if (!emittedBytesWritten) {
         emittedBytesWritten = true;
@@ -319,99 +656,78 @@ bool KPtyDevicePrivate::_k_canWrite()
         emittedBytesWritten = false;
     }
 
-    if (!writeBuffer.isEmpty()) {
-        writeNotifier->setEnabled(true);
+    noteActivity();
+    if (hasPendingWrites()) {
+        enableWriteNotifier();
     }
     return true;
 }
 
-#ifndef timeradd
-// Lifted from GLIBC
-/* clang-format off */
-#define timeradd(a, b, result) \
-    do { \
-        (result)->tv_sec = (a)->tv_sec + (b)->tv_sec; \
-        (result)->tv_usec = (a)->tv_usec + (b)->tv_usec; \
-        if ((result)->tv_usec >= 1000000) { \
-            ++(result)->tv_sec; \
-            (result)->tv_usec -= 1000000; \
-        } \
-    } while (0)
-
-#define timersub(a, b, result) \
-    do { \
-        (result)->tv_sec = (a)->tv_sec - (b)->tv_sec; \
-        (result)->tv_usec = (a)->tv_usec - (b)->tv_usec; \
-        if ((result)->tv_usec < 0) { \
-            --(result)->tv_sec; \
-            (result)->tv_usec += 1000000; \
-        } \
-    } while (0)
-#endif
-/* clang-format on */
-
 bool KPtyDevicePrivate::doWait(int msecs, bool reading)
 {
     Q_Q(KPtyDevice);
-#ifndef Q_OS_LINUX
-    struct timeval etv;
-#endif
-    struct timeval tv;
-    struct timeval *tvp;
-
-    if (msecs < 0) {
-        tvp = nullptr;
-    } else {
-        tv.tv_sec = msecs / 1000;
-        tv.tv_usec = (msecs % 1000) * 1000;
-#ifndef Q_OS_LINUX
-        gettimeofday(&etv, nullptr);
-        timeradd(&tv, &etv, &etv);
-#endif
-        tvp = &tv;
-    }
 
-    while (reading ? readNotifier->isEnabled() : !writeBuffer.isEmpty()) {
-        fd_set rfds;
-        fd_set wfds;
+    const QDeadlineTimer deadline(msecs < 0 ? QDeadlineTimer(QDeadlineTimer::Forever) : QDeadlineTimer(msecs, Qt::PreciseTimer));
 
-        FD_ZERO(&rfds);
-        FD_ZERO(&wfds);
+    while (reading ? (!suspended && !eof) : hasPendingWrites()) {
+        // lagging subscriptions only catch up from the event loop, so
+        // blocking here would not help them
+        if (reading && fanoutBlocked && !hasPendingWrites()) {
+            return false;
+        }
 
-        if (readNotifier->isEnabled()) {
-            FD_SET(q->masterFd(), &rfds);
+        // poll() rather than select(), as there may be more than FD_SETSIZE fds
+        short events = 0;
+        if (!suspended && !eof && !throttled && !readersLagging()) {
+            events |= POLLIN;
+        }
+        if (hasPendingWrites()) {
+            events |= POLLOUT;
         }
-        if (!writeBuffer.isEmpty()) {
-            FD_SET(q->masterFd(), &wfds);
+        struct pollfd fds[2] = {{events ? q->masterFd() : -1, events, 0}, {-1, POLLIN, 0}};
+        // a full shared ring needs a wakeup when the reader made room
+        if (reading && sharedRingBlocked) {
+            fds[1].fd = sharedRing->descriptors.spaceEvent;
         }
 
-#ifndef Q_OS_LINUX
-        if (tvp) {
-            gettimeofday(&tv, nullptr);
-            timersub(&etv, &tv, &tv);
-            if (tv.tv_sec < 0) {
-                tv.tv_sec = tv.tv_usec = 0;
-            }
+        // a throttled read side needs a wakeup when the throttling ends
+        QDeadlineTimer wakeup = deadline;
+        if (throttled && throttleDeadline < wakeup) {
+            wakeup = throttleDeadline;
         }
-#endif
+        // nothing could ever end the wait
+        if (fds[0].fd < 0 && fds[1].fd < 0 && wakeup.isForever()) {
+            return false;
+        }
+        const int timeout = wakeup.isForever() ? -1 : int(qMin<qint64>(wakeup.remainingTime(), KMAXINT));
 
-        switch (select(q->masterFd() + 1, &rfds, &wfds, nullptr, tvp)) {
+        switch (poll(fds, 2, timeout)) {
         case -1:
             if (errno == EINTR) {
                 break;
             }
             return false;
         case 0:
+            if (throttled && throttleDeadline.hasExpired()) {
+                unthrottle();
+                break;
+            }
+            if (!deadline.hasExpired()) {
+                break;
+            }
             q->setErrorString(i18n("PTY operation timed out"));
             return false;
         default:
-            if (FD_ISSET(q->masterFd(), &rfds)) {
+            if (fds[1].revents & POLLIN) {
+                checkSharedRingSpace();
+            }
+            if ((events & POLLIN) && (fds[0].revents & (POLLIN | POLLHUP | POLLERR))) {
                 bool canRead = _k_canRead();
                 if (reading && canRead) {
                     return true;
                 }
             }
-            if (FD_ISSET(q->masterFd(), &wfds)) {
+            if ((events & POLLOUT) && (fds[0].revents & (POLLOUT | POLLHUP | POLLERR))) {
                 bool canWrite = _k_canWrite();
                 if (!reading) {
                     return canWrite;
@@ -427,18 +743,32 @@ void KPtyDevicePrivate::finishOpen(QIODevice::OpenMode mode)
 {
     Q_Q(KPtyDevice);
 
+    // once per process, and not on every write, as the handler is global
+    qt_ignore_sigpipe();
+
     q->QIODevice::open(mode);
     fcntl(q->masterFd(), F_SETFL, O_NONBLOCK);
-    readBuffer.clear();
+    discardReadBuffer();
+    if (tokenizer) {
+        tokenizer->reset();
+    }
+    suspended = false;
+    eof = false;
+    throttled = false;
+    // the write notifier is only created once there is something to write
     readNotifier = new QSocketNotifier(q->masterFd(), QSocketNotifier::Read, q);
-    writeNotifier = new QSocketNotifier(q->masterFd(), QSocketNotifier::Write, q);
     QObject::connect(readNotifier, &QSocketNotifier::activated, q, [this]() {
-        _k_canRead();
-    });
-    QObject::connect(writeNotifier, &QSocketNotifier::activated, q, [this]() {
-        _k_canWrite();
+        if (scheduler) {
+            scheduler->schedule(this);
+        } else {
+            _k_canRead();
+        }
     });
     readNotifier->setEnabled(true);
+    noteActivity();
+    if (foregroundCheckDelay >= 0) {
+        updateForegroundProcess(false);
+    }
 }
 
 /////////////////////////////
@@ -453,13 +783,20 @@ KPtyDevice::KPtyDevice(QObject *parent)
 
 KPtyDevice::~KPtyDevice()
 {
+    Q_D(KPtyDevice);
+
     close();
+    if (d->scheduler) {
+        d->scheduler->q_ptr->removeDevice(this);
+    }
 }
 
 bool KPtyDevice::open(OpenMode mode)
 {
     Q_D(KPtyDevice);
 
+    d->assertThread();
+
     if (masterFd() >= 0) {
         return true;
     }
@@ -478,6 +815,8 @@ bool KPtyDevice::open(int fd, OpenMode mode)
 {
     Q_D(KPtyDevice);
 
+    d->assertThread();
+
     if (!KPty::open(fd)) {
         setErrorString(i18n("Error opening PTY"));
         return false;
@@ -492,18 +831,288 @@ void KPtyDevice::close()
 {
     Q_D(KPtyDevice);
 
+    d->assertThread();
+
     if (masterFd() < 0) {
         return;
     }
 
+    if (d->throttleTimer) {
+        d->throttleTimer->stop();
+    }
+    d->packetMode = false;
+    d->outputSuspended = false;
+    d->termiosTracked = false;
+    d->winSizeRequested = false;
+    if (d->winSizeQuietTimer) {
+        d->winSizeQuietTimer->stop();
+    }
+    if (d->winSizeMaxDelayTimer) {
+        d->winSizeMaxDelayTimer->stop();
+    }
+    if (d->foregroundTimer) {
+        d->foregroundTimer->stop();
+    }
+    d->foregroundPid = -1;
+    d->foregroundName.clear();
+    if (d->scheduler) {
+        d->scheduler->unschedule(d);
+    }
+    if (d->idleTimer) {
+        d->idleTimer->stop();
+    }
     delete d->readNotifier;
     delete d->writeNotifier;
+    d->readNotifier = nullptr;
+    d->writeNotifier = nullptr;
+    setSharedRingExport(0);
 
     QIODevice::close();
 
     KPty::close();
 }
 
+bool KPtyDevice::sendSession(int socket, int msecs)
+{
+    Q_D(KPtyDevice);
+
+    d->assertThread();
+
+    if (masterFd() < 0) {
+        qCWarning(KPTY_LOG) << "Attempting to send a closed pty";
+        return false;
+    }
+
+    // coalesced and batched changes travel along
+    flushWinSize();
+
+    KPtySessionHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = KPTY_SESSION_MAGIC;
+    header.version = KPTY_SESSION_VERSION;
+    header.size = sizeof(header);
+    header.flags = (d->packetMode ? SessionPacketMode : 0) | (d->outputSuspended ? SessionOutputSuspended : 0)
+        | (d->termiosTracked ? SessionTermiosTracked : 0);
+    header.streamOffset = d->readBufferHead();
+    header.readSize = d->readBuffer.size();
+    header.writeSize = d->urgentBuffer.size() + d->writeBuffer.size();
+    if (!tcGetAttr(&header.termios)) {
+        setErrorString(i18n("Error reading PTY attributes"));
+        return false;
+    }
+    if (d->winSizePending) {
+        header.winSize = d->pendingWinSize;
+    } else if (::ioctl(masterFd(), TIOCGWINSZ, (char *)&header.winSize)) {
+        setErrorString(i18n("Error reading PTY window size"));
+        return false;
+    }
+
+    const int fd = masterFd();
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct iovec iov = {&header, sizeof(header)};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+    const QDeadlineTimer deadline(msecs < 0 ? QDeadlineTimer(QDeadlineTimer::Forever) : QDeadlineTimer(msecs, Qt::PreciseTimer));
+    ssize_t sent;
+    for (;;) {
+        sent = sendmsg(socket, &msg, MSG_NOSIGNAL);
+        if (sent >= 0 || (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            break;
+        }
+        if (errno != EINTR && !waitForSocket(socket, POLLOUT, deadline)) {
+            break;
+        }
+    }
+
+    bool ok = sent > 0 && sendAll(socket, reinterpret_cast<const char *>(&header) + sent, sizeof(header) - sent, deadline);
+    for (const KRingBuffer *buffer : {&d->readBuffer, &d->urgentBuffer, &d->writeBuffer}) {
+        buffer->forEachChunk(0, [&](const char *data, int size) {
+            ok = ok && sendAll(socket, data, size, deadline);
+            return ok;
+        });
+    }
+    if (!ok) {
+        setErrorString(i18n("Error sending PTY session"));
+        return false;
+    }
+
+    // the receiver owns the session now, so closing our copy of the
+    // master must not reset the pty
+    d->discardReadBuffer();
+    d->urgentBuffer.clear();
+    d->writeBuffer.clear();
+    const bool ownMaster = d->ownMaster;
+    d->ownMaster = false;
+    close();
+    if (ownMaster) {
+        ::close(fd);
+    }
+    return true;
+}
+
+bool KPtyDevice::receiveSession(int socket, int msecs)
+{
+    Q_D(KPtyDevice);
+
+    d->assertThread();
+
+    if (masterFd() >= 0) {
+        qCWarning(KPTY_LOG) << "Attempting to receive a session into an open pty";
+        return false;
+    }
+
+    KPtySessionHeader header;
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct iovec iov = {&header, sizeof(header)};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    const QDeadlineTimer deadline(msecs < 0 ? QDeadlineTimer(QDeadlineTimer::Forever) : QDeadlineTimer(msecs, Qt::PreciseTimer));
+    ssize_t received;
+    for (;;) {
+        received = recvmsg(socket, &msg, MSG_CMSG_CLOEXEC);
+        if (received >= 0 || (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            break;
+        }
+        if (errno != EINTR && !waitForSocket(socket, POLLIN, deadline)) {
+            break;
+        }
+    }
+
+    int fd = -1;
+    if (received > 0) {
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS && cmsg->cmsg_len == CMSG_LEN(sizeof(int))) {
+                memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+            }
+        }
+    }
+
+    QByteArray readData;
+    QByteArray writeData;
+    bool ok = fd >= 0 && receiveAll(socket, reinterpret_cast<char *>(&header) + received, sizeof(header) - received, deadline)
+        && header.magic == KPTY_SESSION_MAGIC && header.version == KPTY_SESSION_VERSION && header.size == sizeof(header) && header.readSize >= 0
+        && header.readSize <= KMAXINT && header.writeSize >= 0 && header.writeSize <= KMAXINT;
+    if (ok) {
+        readData.resize(header.readSize);
+        writeData.resize(header.writeSize);
+        ok = receiveAll(socket, readData.data(), readData.size(), deadline) && receiveAll(socket, writeData.data(), writeData.size(), deadline);
+    }
+    if (!ok || !open(fd)) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        setErrorString(i18n("Error receiving PTY session"));
+        return false;
+    }
+    d->ownMaster = true;
+
+    // the pty itself carries packet mode and EXTPROC along
+    d->packetMode = header.flags & SessionPacketMode;
+    d->outputSuspended = header.flags & SessionOutputSuspended;
+    d->termiosTracked = header.flags & SessionTermiosTracked;
+    tcSetAttr(&header.termios);
+    ::ioctl(masterFd(), TIOCSWINSZ, (char *)&header.winSize);
+
+    d->rebaseStream(header.streamOffset);
+    if (!readData.isEmpty()) {
+        d->readBuffer.write(readData.constData(), readData.size());
+        d->readBufferEnd += readData.size();
+        QMetaObject::invokeMethod(
+            this,
+            [this]() {
+                Q_D(KPtyDevice);
+                if (!d->subscriptions.isEmpty()) {
+                    d->feedSubscriptions();
+                }
+                if (bytesAvailable()) {
+                    Q_EMIT readyRead();
+                }
+            },
+            Qt::QueuedConnection);
+    }
+    if (!writeData.isEmpty()) {
+        d->writeBuffer.write(writeData.constData(), writeData.size());
+        d->enableWriteNotifier();
+    }
+    return true;
+}
+
+void KPtyDevice::setHistory(KPtyHistory *history)
+{
+    Q_D(KPtyDevice);
+    d->history = history;
+}
+
+KPtyHistory *KPtyDevice::history() const
+{
+    Q_D(const KPtyDevice);
+    return d->history;
+}
+
+void KPtyDevice::setRetentionBuffer(KPtyRetentionBuffer *buffer)
+{
+    Q_D(KPtyDevice);
+    d->retentionBuffer = buffer;
+}
+
+KPtyRetentionBuffer *KPtyDevice::retentionBuffer() const
+{
+    Q_D(const KPtyDevice);
+    return d->retentionBuffer;
+}
+
+bool KPtyDevice::setSharedRingExport(qint64 capacity)
+{
+    Q_D(KPtyDevice);
+
+    d->assertThread();
+
+    delete d->sharedRingNotifier;
+    d->sharedRingNotifier = nullptr;
+    d->sharedRing.reset(); // tells the reader that the export ended
+    d->sharedRingBlocked = false;
+    d->updateReadNotifier();
+    if (capacity <= 0) {
+        return true;
+    }
+
+    std::unique_ptr<KPtySharedRingWriter> ring(new KPtySharedRingWriter);
+    if (!ring->create(capacity)) {
+        qCWarning(KPTY_LOG) << "Can't set up shared ring buffer";
+        return false;
+    }
+    d->sharedRing = std::move(ring);
+    d->sharedRingNotifier = new QSocketNotifier(d->sharedRing->descriptors.spaceEvent, QSocketNotifier::Read, this);
+    d->sharedRingNotifier->setEnabled(false);
+    connect(d->sharedRingNotifier, &QSocketNotifier::activated, this, [d]() {
+        d->checkSharedRingSpace();
+    });
+    return true;
+}
+
+KPtySharedRingReader::Descriptors KPtyDevice::sharedRingDescriptors() const
+{
+    Q_D(const KPtyDevice);
+    return d->sharedRing ? d->sharedRing->descriptors : KPtySharedRingReader::Descriptors();
+}
+
 bool KPtyDevice::isSequential() const
 {
     return true;
@@ -530,55 +1139,617 @@ qint64 KPtyDevice::bytesAvailable() const
 qint64 KPtyDevice::bytesToWrite() const
 {
     Q_D(const KPtyDevice);
-    return d->writeBuffer.size();
+    return d->writeBuffer.size() + d->urgentBuffer.size();
 }
 
 bool KPtyDevice::waitForReadyRead(int msecs)
 {
     Q_D(KPtyDevice);
+    d->assertThread();
     return d->doWait(msecs, true);
 }
 
 bool KPtyDevice::waitForBytesWritten(int msecs)
 {
     Q_D(KPtyDevice);
+    d->assertThread();
     return d->doWait(msecs, false);
 }
 
+QList<KPtyDevice *> KPtyDevice::waitForAny(const QList<KPtyDevice *> &devices, QDeadlineTimer deadline)
+{
+    QList<KPtyDevice *> progressed;
+    QList<QPointer<KPtyDevice>> polled;
+    QList<struct pollfd> fds;
+
+    while (progressed.isEmpty()) {
+        polled.clear();
+        fds.clear();
+        QDeadlineTimer wakeup = deadline;
+        for (KPtyDevice *device : devices) {
+            if (!device || device->masterFd() < 0) {
+                continue;
+            }
+            KPtyDevicePrivate *d = device->d_func();
+            d->assertThread();
+            short events = 0;
+            if (!d->suspended && !d->eof && !d->throttled && !d->readersLagging()) {
+                events |= POLLIN;
+            }
+            if (d->hasPendingWrites()) {
+                events |= POLLOUT;
+            }
+            // a throttled read side needs a wakeup when the throttling ends
+            if (d->throttled && !d->suspended && !d->eof) {
+                if (d->throttleDeadline < wakeup) {
+                    wakeup = d->throttleDeadline;
+                }
+            } else if (!events) {
+                continue;
+            }
+            polled << device;
+            // with no events, the fd would still report a hangup over and over
+            fds.append({events ? device->masterFd() : -1, events, 0});
+        }
+        if (polled.isEmpty()) {
+            break;
+        }
+
+        const int timeout = wakeup.isForever() ? -1 : int(qMin<qint64>(wakeup.remainingTime(), KMAXINT));
+        const int ret = poll(fds.data(), fds.size(), timeout);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        // the signals emitted below may delete devices
+        for (int i = 0; i < polled.size(); ++i) {
+            KPtyDevice *device = polled.at(i);
+            if (!device) {
+                continue;
+            }
+            KPtyDevicePrivate *d = device->d_func();
+            if (d->throttled && d->throttleDeadline.hasExpired()) {
+                d->unthrottle();
+            }
+            const short revents = fds.at(i).revents;
+            bool progress = false;
+            if ((fds.at(i).events & POLLIN) && (revents & (POLLIN | POLLHUP | POLLERR))) {
+                progress = d->_k_canRead();
+                progress = polled.at(i) && (progress || d->eof);
+            }
+            if (polled.at(i) && (revents & POLLOUT)) {
+                progress = d->_k_canWrite() || progress;
+            }
+            if (progress && polled.at(i)) {
+                progressed << device;
+            }
+        }
+
+        if (progressed.isEmpty() && deadline.hasExpired()) {
+            break;
+        }
+    }
+    return progressed;
+}
+
 void KPtyDevice::setSuspended(bool suspended)
 {
     Q_D(KPtyDevice);
-    d->readNotifier->setEnabled(!suspended);
+    d->assertThread();
+    d->suspended = suspended;
+    if (!suspended) {
+        d->eof = false;
+    }
+    d->updateReadNotifier();
+}
+
+void KPtyDevice::setIdleReleaseTimeout(int msecs)
+{
+    Q_D(KPtyDevice);
+
+    d->idleReleaseTimeout = msecs;
+    if (msecs < 0) {
+        delete d->idleTimer;
+        d->idleTimer = nullptr;
+        return;
+    }
+    if (!d->idleTimer) {
+        d->idleTimer = new QTimer(this);
+        connect(d->idleTimer, &QTimer::timeout, this, [d]() {
+            d->checkIdle();
+        });
+    }
+    d->idleTimer->setInterval(msecs);
+    if (masterFd() >= 0) {
+        d->noteActivity();
+    }
+}
+
+void KPtyDevice::setReadChunkSizeLimits(int minimum, int maximum)
+{
+    Q_D(KPtyDevice);
+
+    d->readChunkMinimum = chunkSizeClass(qMax(1, minimum));
+    d->readChunkMaximum = qMax(d->readChunkMinimum, chunkSizeClass(maximum));
+    d->setReadChunkSize(qBound(d->readChunkMinimum, d->readBuffer.currentChunkSize(), d->readChunkMaximum));
+    d->smallReads = 0;
+}
+
+int KPtyDevice::minimumReadChunkSize() const
+{
+    Q_D(const KPtyDevice);
+    return d->readChunkMinimum;
+}
+
+int KPtyDevice::maximumReadChunkSize() const
+{
+    Q_D(const KPtyDevice);
+    return d->readChunkMaximum;
+}
+
+int KPtyDevice::readChunkSize() const
+{
+    Q_D(const KPtyDevice);
+    return d->readBuffer.currentChunkSize();
+}
+
+int KPtyDevice::idleReleaseTimeout() const
+{
+    Q_D(const KPtyDevice);
+    return d->idleReleaseTimeout;
 }
 
 bool KPtyDevice::isSuspended() const
 {
     Q_D(const KPtyDevice);
-    return !d->readNotifier->isEnabled();
+    return d->suspended || d->eof;
+}
+
+void KPtyDevice::setReadRateLimit(qint64 bytesPerSecond, qint64 burst)
+{
+    Q_D(KPtyDevice);
+
+    d->readRateLimit = qMax<qint64>(0, bytesPerSecond);
+    d->readBurst = burst > 0 ? burst : d->readRateLimit;
+    d->tokens = d->readBurst;
+    d->tokenClock.start();
+    if (!d->readRateLimit) {
+        d->unthrottle();
+    }
+}
+
+qint64 KPtyDevice::readRateLimit() const
+{
+    Q_D(const KPtyDevice);
+    return d->readRateLimit;
+}
+
+qint64 KPtyDevice::readBurst() const
+{
+    Q_D(const KPtyDevice);
+    return d->readBurst;
+}
+
+bool KPtyDevice::isThrottled() const
+{
+    Q_D(const KPtyDevice);
+    return d->throttled;
+}
+
+KPtyDevice::Statistics KPtyDevice::statistics() const
+{
+    Q_D(const KPtyDevice);
+
+    Statistics stats = d->stats;
+    if (d->throttled) {
+        stats.throttledTime += d->throttleClock.elapsed();
+    }
+    stats.readRateLimit = d->readRateLimit;
+    stats.readBurst = d->readBurst;
+    return stats;
+}
+
+void KPtyDevice::setWinSizeCoalescing(int quietPeriod, int maxDelay)
+{
+    Q_D(KPtyDevice);
+
+    d->winSizeQuietPeriod = qMax(0, quietPeriod);
+    d->winSizeMaxDelay = maxDelay;
+    if (!d->winSizeQuietPeriod) {
+        flushWinSize();
+    }
+}
+
+int KPtyDevice::winSizeQuietPeriod() const
+{
+    Q_D(const KPtyDevice);
+    return d->winSizeQuietPeriod;
+}
+
+int KPtyDevice::winSizeMaxDelay() const
+{
+    Q_D(const KPtyDevice);
+    return d->winSizeMaxDelay;
+}
+
+bool KPtyDevice::requestWinSize(int lines, int columns, int height, int width)
+{
+    Q_D(KPtyDevice);
+
+    if (!d->winSizeQuietPeriod) {
+        return setWinSize(lines, columns, height, width);
+    }
+
+    d->requestedWinSize[0] = lines;
+    d->requestedWinSize[1] = columns;
+    d->requestedWinSize[2] = height;
+    d->requestedWinSize[3] = width;
+    if (!d->winSizeRequested) {
+        d->winSizeRequested = true;
+        if (d->winSizeMaxDelay >= 0) {
+            d->startWinSizeTimer(d->winSizeMaxDelayTimer, d->winSizeMaxDelay);
+        }
+    }
+    d->startWinSizeTimer(d->winSizeQuietTimer, d->winSizeQuietPeriod);
+    return true;
+}
+
+bool KPtyDevice::flushWinSize()
+{
+    Q_D(KPtyDevice);
+
+    if (d->winSizeQuietTimer) {
+        d->winSizeQuietTimer->stop();
+    }
+    if (d->winSizeMaxDelayTimer) {
+        d->winSizeMaxDelayTimer->stop();
+    }
+    if (!d->winSizeRequested) {
+        return true;
+    }
+    d->winSizeRequested = false;
+    const int *size = d->requestedWinSize;
+    return setWinSize(size[0], size[1], size[2], size[3]);
+}
+
+bool KPtyDevice::hasPendingWinSize() const
+{
+    Q_D(const KPtyDevice);
+    return d->winSizeRequested;
+}
+
+bool KPtyDevice::setPacketMode(bool enable)
+{
+    Q_D(KPtyDevice);
+
+#ifdef TIOCPKT
+    int on = enable;
+    if (::ioctl(masterFd(), TIOCPKT, &on)) {
+        setErrorString(i18n("Error setting PTY packet mode"));
+        return false;
+    }
+    d->packetMode = enable;
+    if (!enable) {
+        d->outputSuspended = false;
+    }
+    return true;
+#else
+    if (enable) {
+        setErrorString(i18n("PTY packet mode is not supported"));
+    }
+    return !enable;
+#endif
+}
+
+bool KPtyDevice::isPacketMode() const
+{
+    Q_D(const KPtyDevice);
+    return d->packetMode;
+}
+
+bool KPtyDevice::setTermiosTracking(bool enable)
+{
+    Q_D(KPtyDevice);
+
+#if defined(EXTPROC) && defined(TIOCPKT_IOCTL)
+    if (enable && !d->packetMode && !setPacketMode(true)) {
+        return false;
+    }
+    if (!beginTermiosUpdate()) {
+        setErrorString(i18n("Error reading PTY attributes"));
+        return false;
+    }
+    if (enable) {
+        d->termios.c_lflag |= EXTPROC;
+    } else {
+        d->termios.c_lflag &= ~EXTPROC;
+    }
+    if (!commitTermiosUpdate()) {
+        setErrorString(i18n("Error setting PTY attributes"));
+        return false;
+    }
+    d->termiosTracked = enable;
+    // the commit could not trust the cache yet
+    d->termiosCached = enable;
+    return true;
+#else
+    if (enable) {
+        setErrorString(i18n("Tracking PTY attributes is not supported"));
+    }
+    return !enable;
+#endif
+}
+
+bool KPtyDevice::isTermiosTracking() const
+{
+    Q_D(const KPtyDevice);
+    return d->termiosTracked;
+}
+
+bool KPtyDevice::isOutputSuspended() const
+{
+    Q_D(const KPtyDevice);
+    return d->outputSuspended;
+}
+
+void KPtyDevice::setForegroundProcessTracking(bool enable, int delay)
+{
+    Q_D(KPtyDevice);
+
+    d->foregroundCheckDelay = enable ? qMax(0, delay) : -1;
+    if (!enable) {
+        if (d->foregroundTimer) {
+            d->foregroundTimer->stop();
+        }
+        d->foregroundPid = -1;
+        d->foregroundName.clear();
+    } else if (masterFd() >= 0) {
+        d->updateForegroundProcess(false);
+    }
+}
+
+bool KPtyDevice::isForegroundProcessTracking() const
+{
+    Q_D(const KPtyDevice);
+    return d->foregroundCheckDelay >= 0;
+}
+
+qint64 KPtyDevice::foregroundProcessId() const
+{
+    Q_D(const KPtyDevice);
+    return d->foregroundPid;
+}
+
+QString KPtyDevice::foregroundProcessName() const
+{
+    Q_D(const KPtyDevice);
+    return d->foregroundName;
+}
+
+bool KPtyDevice::discardPendingOutput(int signal)
+{
+    Q_D(KPtyDevice);
+
+    d->assertThread();
+
+    if (masterFd() < 0) {
+        return false;
+    }
+
+    // TCIFLUSH, as the output of the slave is the input of the master
+    bool ok = !tcflush(masterFd(), TCIFLUSH);
+    if (!ok) {
+        setErrorString(i18n("Error flushing PTY"));
+    }
+
+    d->discardReadBuffer();
+    if (d->tokenizer) {
+        d->tokenizer->reset();
+    }
+    if (const qint64 buffered = QIODevice::bytesAvailable()) {
+        skip(buffered);
+    }
+    if (d->scheduler) {
+        d->scheduler->unschedule(d);
+    }
+
+    if (signal) {
+#ifdef TIOCSIG
+        if (::ioctl(masterFd(), TIOCSIG, signal)) {
+#else
+        const pid_t pgrp = tcgetpgrp(slaveFd() >= 0 ? slaveFd() : masterFd());
+        if (pgrp <= 0 || ::kill(-pgrp, signal)) {
+#endif
+            setErrorString(i18n("Error sending signal to the PTY's foreground process group"));
+            ok = false;
+        }
+    }
+
+    return ok;
+}
+
+qint64 KPtyDevice::write(const char *data, qint64 len, WriteFlags flags)
+{
+    Q_D(KPtyDevice);
+
+    d->assertThread();
+
+    if (!isWritable()) {
+        qCWarning(KPTY_LOG) << "KPtyDevice::write: device not open for writing";
+        return -1;
+    }
+    Q_ASSERT(len <= KMAXINT);
+
+    if (flags & WriteFlag::DiscardPending) {
+        d->writeBuffer.clear();
+    }
+    if (!(flags & WriteFlag::Urgent)) {
+        return QIODevice::write(data, len);
+    }
+    if (len > 0) {
+        d->urgentBuffer.write(data, len);
+        d->enableWriteNotifier();
+    }
+    return len;
+}
+
+qint64 KPtyDevice::write(const QByteArray &data, WriteFlags flags)
+{
+    return write(data.constData(), data.size(), flags);
+}
+
+qint64 KPtyDevice::write(const char *data, WriteFlags flags)
+{
+    return write(data, qstrlen(data), flags);
+}
+
+qint64 KPtyDevice::utf8BytesAvailable() const
+{
+    Q_D(const KPtyDevice);
+    return d->completeUtf8Size(KMAXINT);
+}
+
+QByteArray KPtyDevice::readUtf8(qint64 maxSize)
+{
+    Q_D(KPtyDevice);
+
+    d->assertThread();
+
+    const int size = d->completeUtf8Size(maxSize > 0 ? int(qMin<qint64>(maxSize, KMAXINT)) : KMAXINT);
+    return size > 0 ? read(size) : QByteArray();
+}
+
+QString KPtyDevice::readText(qint64 maxSize)
+{
+    return QString::fromUtf8(readUtf8(maxSize));
+}
+
+void KPtyDevice::setReadSink(const std::function<QSpan<char>(qsizetype hint)> &acquire, const std::function<void(QSpan<char> data)> &commit)
+{
+    Q_D(KPtyDevice);
+
+    d->assertThread();
+
+    // one without the other can't work
+    if (!acquire || !commit) {
+        d->readSinkAcquire = nullptr;
+        d->readSinkCommit = nullptr;
+        return;
+    }
+    d->readSinkAcquire = acquire;
+    d->readSinkCommit = commit;
+}
+
+bool KPtyDevice::hasReadSink() const
+{
+    Q_D(const KPtyDevice);
+    return bool(d->readSinkAcquire);
+}
+
+void KPtyDevice::setTokenizing(bool enable)
+{
+    Q_D(KPtyDevice);
+
+    d->assertThread();
+
+    if (!enable) {
+        d->tokenizer.reset();
+    } else if (!d->tokenizer) {
+        d->tokenizer.reset(new KPtyTokenizer);
+        qint64 offset = d->readBufferHead();
+        d->readBuffer.forEachChunk(0, [d, &offset](const char *data, int size) {
+            d->tokenizer->feed(data, size, offset);
+            offset += size;
+            return true;
+        });
+    }
+}
+
+bool KPtyDevice::isTokenizing() const
+{
+    Q_D(const KPtyDevice);
+    return bool(d->tokenizer);
+}
+
+QList<KPtyDevice::Run> KPtyDevice::runs() const
+{
+    Q_D(const KPtyDevice);
+
+    QList<Run> result;
+    if (!d->tokenizer) {
+        return result;
+    }
+    // runs which were consumed are only pruned with the next read
+    const qint64 head = d->readBufferHead();
+    for (const Run &run : std::as_const(d->tokenizer->runs)) {
+        const qint64 end = run.offset + run.length;
+        if (end > head) {
+            const qint64 start = qMax(run.offset, head);
+            result.append({run.type, start - head, end - start});
+        }
+    }
+    return result;
+}
+
+KPtyAwaitable KPtyDevice::readSomeAsync(qint64 maxSize)
+{
+    auto awaitable = std::make_unique<KPtyAwaitablePrivate>(this, KPtyAwaitablePrivate::ReadSome);
+    awaitable->maxSize = maxSize;
+    return KPtyAwaitable(std::move(awaitable));
+}
+
+KPtyAwaitable KPtyDevice::readLineAsync()
+{
+    return KPtyAwaitable(std::make_unique<KPtyAwaitablePrivate>(this, KPtyAwaitablePrivate::ReadLine));
+}
+
+KPtyAwaitable KPtyDevice::readUntilAsync(const QByteArray &delimiter)
+{
+    auto awaitable = std::make_unique<KPtyAwaitablePrivate>(this, KPtyAwaitablePrivate::ReadUntil);
+    awaitable->setDelimiter(delimiter);
+    return KPtyAwaitable(std::move(awaitable));
+}
+
+KPtyAwaitable KPtyDevice::drainAsync()
+{
+    return KPtyAwaitable(std::make_unique<KPtyAwaitablePrivate>(this, KPtyAwaitablePrivate::Drain));
 }
 
 // protected
 qint64 KPtyDevice::readData(char *data, qint64 maxlen)
 {
     Q_D(KPtyDevice);
-    return d->readBuffer.read(data, (int)qMin<qint64>(maxlen, KMAXINT));
+    d->assertThread();
+    const qint64 size = d->readBuffer.read(data, (int)qMin<qint64>(maxlen, KMAXINT));
+    if (!d->subscriptions.isEmpty()) {
+        d->trimFanout();
+    }
+    return size;
 }
 
 // protected
 qint64 KPtyDevice::readLineData(char *data, qint64 maxlen)
 {
     Q_D(KPtyDevice);
-    return d->readBuffer.readLine(data, (int)qMin<qint64>(maxlen, KMAXINT));
+    const qint64 size = d->readBuffer.readLine(data, (int)qMin<qint64>(maxlen, KMAXINT));
+    if (!d->subscriptions.isEmpty()) {
+        d->trimFanout();
+    }
+    return size;
 }
 
 // protected
 qint64 KPtyDevice::writeData(const char *data, qint64 len)
 {
     Q_D(KPtyDevice);
+    d->assertThread();
     Q_ASSERT(len <= KMAXINT);
 
     d->writeBuffer.write(data, len);
-    d->writeNotifier->setEnabled(true);
+    d->enableWriteNotifier();
     return len;
 }
 
@@ -9,16 +9,35 @@
 #define kptydev_h
 
 #include "kpty.h"
+#include "kptysharedring.h"
 
+#include <QDeadlineTimer>
 #include <QIODevice>
+#include <QList>
+#include <QSpan>
 
+#include <functional>
+
+class KPtyAwaitable;
 class KPtyDevicePrivate;
+class KPtyHistory;
+class KPtyRetentionBuffer;
 
 /*!
  * \class KPtyDevice
  * \inmodule KPty
  *
  * \brief Encapsulates KPty into a QIODevice, so it can be used with Q*Stream, etc.
+ *
+ * \section1 Threads
+ *
+ * Like any QObject, a KPtyDevice has an affinity to the thread it lives in,
+ * and must only be used from that thread; its notifiers and timers are
+ * served by that thread's event loop. Devices living in different threads
+ * share no state, so sessions can be spread over any number of threads,
+ * each with its own event loop or driving its devices with waitForAny().
+ * moveToThread() takes the notifiers and timers of the device along.
+ * Debug builds assert that the device is used from the right thread.
  */
 class KPTY_EXPORT KPtyDevice : public QIODevice, public KPty // krazy:exclude=dpointer (via macro)
 {
@@ -26,6 +45,102 @@ class KPTY_EXPORT KPtyDevice : public QIODevice, public KPty // krazy:exclude=dp
     Q_DECLARE_PRIVATE_D(KPty::d_ptr, KPtyDevice)
 
 public:
+    /*!
+     * \class KPtyDevice::Statistics
+     * \inmodule KPty
+     *
+     * \brief Traffic counters of a pty device.
+     *
+     * \since 6.28
+     */
+    struct Statistics {
+        /*!
+         * \variable KPtyDevice::Statistics::bytesRead
+         * The amount of data read from the pty
+         */
+        qint64 bytesRead = 0;
+        /*!
+         * \variable KPtyDevice::Statistics::bytesWritten
+         * The amount of data written to the pty
+         */
+        qint64 bytesWritten = 0;
+        /*!
+         * \variable KPtyDevice::Statistics::throttleCount
+         * How often reading was paused by the rate limit
+         */
+        qint64 throttleCount = 0;
+        /*!
+         * \variable KPtyDevice::Statistics::throttledTime
+         * The total time reading was paused by the rate limit, in milliseconds
+         */
+        qint64 throttledTime = 0;
+        /*!
+         * \variable KPtyDevice::Statistics::readRateLimit
+         * The current rate limit, in bytes per second, or 0 if unlimited
+         */
+        qint64 readRateLimit = 0;
+        /*!
+         * \variable KPtyDevice::Statistics::readBurst
+         * The current burst size of the rate limit, in bytes
+         */
+        qint64 readBurst = 0;
+    };
+
+    /*!
+     * \value NoWriteFlags Queue the data behind everything written before
+     * \value Urgent Queue the data in a separate lane which is flushed
+     *        ahead of all regularly written data
+     * \value DiscardPending Discard the regularly written data which was
+     *        not passed to the pty yet
+     *
+     * \since 6.28
+     */
+    enum class WriteFlag {
+        NoWriteFlags = 0,
+        Urgent = 1,
+        DiscardPending = 2,
+    };
+    Q_DECLARE_FLAGS(WriteFlags, WriteFlag)
+
+    /*!
+     * \value Text Printable text, i.e., no C0 controls and no DEL
+     * \value Control One or more control sequences, i.e., C0 controls
+     *        and escape sequences including their parameters and
+     *        string payloads
+     *
+     * \since 6.28
+     */
+    enum class RunType {
+        Text,
+        Control,
+    };
+
+    /*!
+     * \class KPtyDevice::Run
+     * \inmodule KPty
+     *
+     * \brief A run of the output of the same type, see runs().
+     *
+     * \since 6.28
+     */
+    struct Run {
+        /*!
+         * \variable KPtyDevice::Run::type
+         * The type of the run
+         */
+        RunType type = RunType::Text;
+        /*!
+         * \variable KPtyDevice::Run::offset
+         * The offset of the run, relative to the next byte to read
+         */
+        qint64 offset = 0;
+        /*!
+         * \variable KPtyDevice::Run::length
+         * The length of the run
+         */
+        qint64 length = 0;
+    };
+
     /*!
      * Constructor
      */
@@ -68,6 +183,56 @@ public:
      */
     void close() override;
 
+    /*!
+     * Hand the session over to another process, e.g. a new instance of a
+     * session daemon which is restarting.
+     *
+     * The pty master is passed through the Unix domain stream socket
+     * \a socket with SCM_RIGHTS, along with the data which was read but
+     * not consumed yet, the data which was written but not passed to the
+     * pty yet, the terminal attributes and the window size, including
+     * changes which are still being batched or coalesced. The receiving
+     * process resumes the session with receiveSession(); the data still
+     * in the pty is read by the receiver, so no data is lost.
+     *
+     * On success, the device is closed, without resetting the pty. The
+     * processes running in the pty are not affected, but remain children
+     * of the sending process.
+     *
+     * \a socket a connected Unix domain stream socket. If it is
+     *  non-blocking, this still blocks until the session is sent.
+     *
+     * \a msecs the time to wait for the socket, or -1 to wait forever
+     *
+     * Returns true on success. On failure, the device remains open.
+     *
+     * \since 6.28
+     */
+    bool sendSession(int socket, int msecs = 30000);
+
+    /*!
+     * Resume a session handed over with sendSession().
+     *
+     * The device must be closed. The pty is opened with the default mode,
+     * and the device takes ownership of the received master, i.e., close()
+     * closes it. Data which the sender had read but not consumed yet is
+     * available right away, and announced with readyRead() from the event
+     * loop; data which the sender had not written yet is written.
+     *
+     * Stream offsets, such as KPtySubscription::streamPosition(), continue
+     * where they were in the sender. Subscriptions of this device keep the
+     * output they did not read yet, and then read the received data.
+     *
+     * \a socket a connected Unix domain stream socket
+     *
+     * \a msecs the time to wait for the session, or -1 to wait forever
+     *
+     * Returns true on success
+     *
+     * \since 6.28
+     */
+    bool receiveSession(int socket, int msecs = 30000);
+
     /*!
      * Sets whether the KPtyDevice monitors the pty for incoming data.
      *
@@ -92,6 +257,608 @@ public:
      */
     bool isSuspended() const;
 
+    /*!
+     * Sets after how long without traffic the resources of the device
+     * are released.
+     *
+     * The buffers of a device keep a chunk of memory around for reuse even
+     * when they are empty, and a notifier is kept for writing once data was
+     * written. With many mostly idle sessions, this adds up, so they can be
+     * released once there was no data read or written for at least
+     * \a msecs milliseconds. They are allocated again on the next use.
+     * Unconsumed and unwritten data is not affected.
+     *
+     * \a msecs the idle period, or -1 to keep the resources, which is the
+     *  default
+     *
+     * \since 6.28
+     */
+    void setIdleReleaseTimeout(int msecs);
+
+    /*!
+     * Returns the idle period after which the resources of the device are
+     * released, in milliseconds, or -1 if they are kept
+     *
+     * \since 6.28
+     */
+    int idleReleaseTimeout() const;
+
+    /*!
+     * Sets the limits of the size of the chunks the read buffer allocates.
+     *
+     * The chunk size follows the amount of data the pty has ready: it
+     * grows right away to hold a burst in a single chunk, and shrinks by
+     * half after a series of much smaller reads, or back to \a minimum when
+     * the resources of an idle device are released. Sizes are rounded up
+     * to powers of two, so chunks fall into few allocator size classes.
+     * No more than \a maximum bytes are read at once.
+     *
+     * Raise \a maximum for high-throughput sessions, lower \a minimum for
+     * many mostly idle sessions; equal limits give a fixed chunk size.
+     *
+     * \a minimum the smallest chunk size, 4096 by default
+     *
+     * \a maximum the largest chunk size, 65536 by default
+     *
+     * \sa setIdleReleaseTimeout()
+     * \since 6.28
+     */
+    void setReadChunkSizeLimits(int minimum, int maximum);
+
+    /*!
+     * Returns the smallest chunk size of the read buffer
+     *
+     * \since 6.28
+     */
+    int minimumReadChunkSize() const;
+
+    /*!
+     * Returns the largest chunk size of the read buffer
+     *
+     * \since 6.28
+     */
+    int maximumReadChunkSize() const;
+
+    /*!
+     * Returns the current chunk size of the read buffer
+     *
+     * \since 6.28
+     */
+    int readChunkSize() const;
+
+    /*!
+     * Limits the rate at which data is read from the pty.
+     *
+     * The limit is enforced with a token bucket: up to \a burst bytes may
+     * be read at once, after which reading continues at \a bytesPerSecond
+     * on average. While the bucket is empty, the KPtyDevice stops reading
+     * altogether, so the kernel's pty buffer fills up and eventually
+     * blocks the writing process. Reading resumes automatically.
+     *
+     * The limit can be changed at any time. Throttling is independent of
+     * setSuspended().
+     *
+     * \a bytesPerSecond the average rate, or 0 to remove the limit
+     *
+     * \a burst the size of the bucket in bytes. If 0, it holds one
+     *  second's worth of data.
+     *
+     * \since 6.28
+     */
+    void setReadRateLimit(qint64 bytesPerSecond, qint64 burst = 0);
+
+    /*!
+     * Returns the read rate limit in bytes per second, or 0 if unlimited
+     *
+     * \since 6.28
+     */
+    qint64 readRateLimit() const;
+
+    /*!
+     * Returns the burst size of the read rate limit in bytes
+     *
+     * \since 6.28
+     */
+    qint64 readBurst() const;
+
+    /*!
+     * Returns true if reading is currently paused by the rate limit
+     *
+     * \since 6.28
+     */
+    bool isThrottled() const;
+
+    /*!
+     * Returns the traffic counters of the device
+     *
+     * \since 6.28
+     */
+    Statistics statistics() const;
+
+    /*!
+     * Sets a store which all data read from the pty is appended to.
+     *
+     * The data is appended as soon as it is read, independently of
+     * whether and when it is consumed through the QIODevice interface.
+     *
+     * \a history an open history store, or nullptr to detach the current
+     *  one. The ownership remains with the caller; the store must outlive
+     *  the device or be detached before being deleted.
+     *
+     * \since 6.28
+     */
+    void setHistory(KPtyHistory *history);
+
+    /*!
+     * Returns the history store data is appended to, if any
+     *
+     * \since 6.28
+     */
+    KPtyHistory *history() const;
+
+    /*!
+     * Sets a buffer which retains the most recent data read from the pty.
+     *
+     * Like with setHistory(), the data is retained as soon as it is read.
+     *
+     * \a buffer a retention buffer, or nullptr to detach the current one.
+     *  The ownership remains with the caller; the buffer must outlive the
+     *  device or be detached before being deleted.
+     *
+     * \since 6.28
+     */
+    void setRetentionBuffer(KPtyRetentionBuffer *buffer);
+
+    /*!
+     * Returns the buffer retaining the most recent data, if any
+     *
+     * \since 6.28
+     */
+    KPtyRetentionBuffer *retentionBuffer() const;
+
+    /*!
+     * Exports all data read from the pty to a ring buffer in shared
+     * memory, to be read by a KPtySharedRingReader, typically in another
+     * process, such as an out-of-process renderer.
+     *
+     * Like with setHistory(), the data is exported as soon as it is read.
+     * If the ring is full, reading from the pty is held back until the
+     * reader made room, so the reader sees all the output.
+     *
+     * The export ends when the device is closed. Changing the capacity
+     * starts a new ring, which needs to be passed to the reader again.
+     *
+     * \a capacity the size of the ring in bytes, rounded up to a power of
+     *  two of at least 4096, or 0 to end the export
+     *
+     * Returns true on success, false if shared memory is not supported
+     *  on this platform or could not be set up
+     *
+     * \since 6.28
+     */
+    bool setSharedRingExport(qint64 capacity);
+
+    /*!
+     * Returns the descriptors to pass to the reader of the exported ring,
+     * or invalid descriptors if there is no export
+     *
+     * The descriptors remain owned by the device and are closed when the
+     * export ends.
+     *
+     * \since 6.28
+     */
+    KPtySharedRingReader::Descriptors sharedRingDescriptors() const;
+
+    /*!
+     * Sets whether the pty reports line discipline events in-band.
+     *
+     * In packet mode (TIOCPKT), the driver reports when the slave side
+     * suspends or resumes output (usually in response to Ctrl-S and
+     * Ctrl-Q), flushes its queues or changes its flow control settings.
+     * The reports are taken apart from the data as it is read, and emitted
+     * as outputSuspended(), outputResumed(), inputFlushed(),
+     * outputFlushed() and flowControlChanged(), so there is no need to
+     * poll the terminal attributes for these events.
+     *
+     * The data read from the device is not affected.
+     *
+     * Do not use on closed ptys. Closing the pty disables packet mode.
+     *
+     * Returns true on success, false if the platform does not support
+     *  packet mode
+     *
+     * \since 6.28
+     */
+    bool setPacketMode(bool enable);
+
+    /*!
+     * Returns true if the pty is in packet mode
+     *
+     * \since 6.28
+     */
+    bool isPacketMode() const;
+
+    /*!
+     * Sets whether changes of the terminal attributes are reported.
+     *
+     * This sets the EXTPROC local mode flag, which makes the driver report
+     * every change of the attributes in packet mode, so termiosChanged()
+     * can be emitted as soon as e.g. a password prompt turns off echo.
+     * Packet mode is enabled if needed. While tracking, the attributes
+     * cached by KPty are trusted across beginTermiosUpdate() batches,
+     * and tcGetAttr() does not touch the pty at all.
+     *
+     * \warning EXTPROC means that input processing happens outside of the
+     * line discipline: input written to the pty is passed to the slave side
+     * without line editing, echo, or the generation of signals from
+     * characters like Ctrl-C, even if the attributes ask for them. The
+     * application has to provide these itself, using the attributes
+     * reported by termiosChanged(), and send signals with
+     * discardPendingOutput().
+     *
+     * Only supported on Linux and platforms with a compatible EXTPROC
+     * implementation.
+     *
+     * Returns true on success, false if tracking is not supported
+     *
+     * \since 6.28
+     */
+    bool setTermiosTracking(bool enable);
+
+    /*!
+     * Returns true if changes of the terminal attributes are tracked
+     *
+     * \since 6.28
+     */
+    bool isTermiosTracking() const;
+
+    /*!
+     * Returns true if the slave side suspended its output, as reported
+     * in packet mode
+     *
+     * \since 6.28
+     */
+    bool isOutputSuspended() const;
+
+    /*!
+     * Set how requestWinSize() coalesces window size changes.
+     *
+     * A size change makes the foreground application redraw its screen,
+     * so applying each step of an interactive resize mostly produces
+     * output which is outdated by the time it is read. With coalescing
+     * enabled, only the most recently requested size is applied, once no
+     * further request came in for \a quietPeriod milliseconds, but no
+     * later than \a maxDelay milliseconds after the first pending request.
+     *
+     * \a quietPeriod the time without requests after which the size is
+     *  applied, or 0 to apply each request immediately
+     *
+     * \a maxDelay the maximal time a request is held back, or -1 for no
+     *  limit. Limits the rate of size changes during long resizes.
+     *
+     * \since 6.28
+     */
+    void setWinSizeCoalescing(int quietPeriod, int maxDelay = -1);
+
+    /*!
+     * Returns the quiet period after which a requested window size is
+     * applied, in milliseconds, or 0 if coalescing is disabled
+     *
+     * \since 6.28
+     */
+    int winSizeQuietPeriod() const;
+
+    /*!
+     * Returns the maximal time a requested window size is held back, in
+     * milliseconds, or -1 if unlimited
+     *
+     * \since 6.28
+     */
+    int winSizeMaxDelay() const;
+
+    /*!
+     * Request a change of the logical (screen) size of the pty.
+     *
+     * Like setWinSize(), but subject to setWinSizeCoalescing(). A size
+     * passed to setWinSize() directly is overridden by a pending request
+     * once it is applied.
+     *
+     * Returns true if the size was applied or is pending, false if
+     *  applying it failed
+     *
+     * \since 6.28
+     */
+    bool requestWinSize(int lines, int columns, int height = 0, int width = 0);
+
+    /*!
+     * Apply a pending window size request immediately.
+     *
+     * Returns true if there was nothing to apply or applying succeeded
+     *
+     * \since 6.28
+     */
+    bool flushWinSize();
+
+    /*!
+     * Returns true if a requested window size was not applied yet
+     *
+     * \since 6.28
+     */
+    bool hasPendingWinSize() const;
+
+    /*!
+     * Sets whether the foreground process group of the pty is tracked.
+     *
+     * Instead of polling, the foreground process group is only looked up
+     * again when there are hints that it may have changed: new output, EOF,
+     * or, with setTermiosTracking(), a change of the terminal attributes.
+     * The lookups are coalesced, so there is at most one per \a delay
+     * milliseconds, and the name of the process is only read when the
+     * group changed. A job which switches programs without producing output
+     * or changing the attributes is noticed with the next output.
+     *
+     * The process group is identified by the ID of its leader, which is
+     * usually the process started by the shell for the job.
+     *
+     * \a enable whether to track the foreground process
+     *
+     * \a delay how long to wait after a hint before looking up the
+     *  foreground process group, in milliseconds
+     *
+     * \since 6.28
+     */
+    void setForegroundProcessTracking(bool enable, int delay = 100);
+
+    /*!
+     * Returns true if the foreground process group is tracked
+     *
+     * \since 6.28
+     */
+    bool isForegroundProcessTracking() const;
+
+    /*!
+     * Returns the ID of the foreground process group as of the last
+     * lookup, or -1 if there is none or it is not tracked
+     *
+     * \sa setForegroundProcessTracking()
+     * \since 6.28
+     */
+    qint64 foregroundProcessId() const;
+
+    /*!
+     * Returns the name of the leader of the foreground process group as of
+     * the last lookup, or an empty string if it is unknown
+     *
+     * The name is only available on Linux.
+     *
+     * \sa setForegroundProcessTracking()
+     * \since 6.28
+     */
+    QString foregroundProcessName() const;
+
+    /*!
+     * Discard all output which was not consumed yet.
+     *
+     * This drops both the output held in the device's buffer and the
+     * output the kernel has queued for the master side of the pty, so
+     * that e.g. an interrupted flood of output stops immediately, instead
+     * of continuing to scroll by. Output written by the child after the
+     * call is read as usual.
+     *
+     * \a signal if not 0, the signal to send to the foreground process
+     *  group of the pty right after flushing, e.g. SIGINT
+     *
+     * Returns true on success
+     *
+     * \since 6.28
+     */
+    bool discardPendingOutput(int signal = 0);
+
+    using QIODevice::write;
+
+    /*!
+     * Write data with special queueing semantics.
+     *
+     * This is meant for input which must not wait for a large amount of
+     * previously written data to drain, like an interrupt character typed
+     * after pasting a huge text. Use \c{WriteFlag::Urgent |
+     * WriteFlag::DiscardPending} to also
+     * drop the rest of the pasted text. Data already passed to the pty is
+     * not affected; the line discipline discards its own input queue when
+     * it generates a signal from an interrupt character, unless NOFLSH is
+     * set.
+     *
+     * Urgent data is inserted between two writes to the pty, so it may end
+     * up in the middle of a regularly written multi-byte sequence.
+     *
+     * \a data the data to write
+     *
+     * \a len the size of \a data
+     *
+     * \a flags how to queue the data
+     *
+     * Returns the number of bytes queued, or -1 on error
+     *
+     * \since 6.28
+     */
+    qint64 write(const char *data, qint64 len, WriteFlags flags);
+
+    /*!
+     * \overload
+     *
+     * \since 6.28
+     */
+    qint64 write(const QByteArray &data, WriteFlags flags);
+
+    /*!
+     * \overload
+     *
+     * Writes the null-terminated string \a data.
+     *
+     * \since 6.28
+     */
+    qint64 write(const char *data, WriteFlags flags);
+
+    /*!
+     * Returns the amount of data which can be read with readUtf8(), i.e.,
+     * the available data up to the last complete UTF-8 code point
+     *
+     * A trailing incomplete multi-byte sequence is held back until it is
+     * complete, or until EOF. Invalid sequences are not held back, as
+     * they never complete.
+     *
+     * \since 6.28
+     */
+    qint64 utf8BytesAvailable() const;
+
+    /*!
+     * Read data ending on a complete UTF-8 code point.
+     *
+     * Output is often read in the middle of a multi-byte character; the
+     * rest of it is left in the device for the next call, so the result
+     * can be decoded without carrying partial sequences along.
+     *
+     * \a maxSize the maximal amount of data to read, or 0 for no limit
+     *
+     * \sa utf8BytesAvailable()
+     * \since 6.28
+     */
+    QByteArray readUtf8(qint64 maxSize = 0);
+
+    /*!
+     * Like readUtf8(), but returns the data decoded to UTF-16.
+     *
+     * Invalid sequences are replaced with U+FFFD.
+     *
+     * \a maxSize the maximal amount of data to read in bytes, or 0 for no
+     *  limit
+     *
+     * \since 6.28
+     */
+    QString readText(qint64 maxSize = 0);
+
+    /*!
+     * Sets a sink which the data is read into directly from the pty.
+     *
+     * This is meant for consumers with buffers of their own which only
+     * need each byte once, like log shippers and recorders. The read
+     * buffer is bypassed, so the data is not copied, and neither readyRead()
+     * is emitted nor can the data be read through the QIODevice interface.
+     * Data which is already buffered remains readable.
+     *
+     * The history, the retention buffer, subscriptions and the shared
+     * ring export are still fed, and stream offsets keep counting. Pattern
+     * matching with KPtyExpect and splitting into runs need the read
+     * buffer, so they see no data while a sink is set.
+     *
+     * \a acquire is called before each read with the amount of data the
+     *  pty has ready, and returns the memory to read into. Returning an
+     *  empty span suspends reading, see setSuspended().
+     *
+     * \a commit is called after each acquire with the part of the memory
+     *  which was filled; it is empty if nothing was read, e.g. at EOF.
+     *
+     * Pass empty functions to return to the read buffer.
+     *
+     * \since 6.28
+     */
+    void setReadSink(const std::function<QSpan<char>(qsizetype hint)> &acquire, const std::function<void(QSpan<char> data)> &commit);
+
+    /*!
+     * Returns true if the data is read into a sink
+     *
+     * \sa setReadSink()
+     * \since 6.28
+     */
+    bool hasReadSink() const;
+
+    /*!
+     * Sets whether the output is split into runs of printable text and
+     * control sequences as it is read.
+     *
+     * Terminal emulators spend most of their time looking for the next
+     * control character in plain text. The splitting is done with vector
+     * instructions where the CPU supports them, so consumers can take
+     * the runs from runs() and pass text runs to a fast path.
+     *
+     * Output which is already buffered is split right away.
+     *
+     * \since 6.28
+     */
+    void setTokenizing(bool enable);
+
+    /*!
+     * Returns true if the output is split into runs
+     *
+     * \since 6.28
+     */
+    bool isTokenizing() const;
+
+    /*!
+     * Returns the runs making up the data available for reading, with
+     * offsets relative to the next byte to read
+     *
+     * Text and control runs alternate. The first run may start in the
+     * middle of a control sequence which was partially read already. The
+     * last run may be a control sequence which is not complete yet; it
+     * grows with the next read.
+     *
+     * The result is empty unless tokenizing is enabled.
+     *
+     * \sa setTokenizing()
+     * \since 6.28
+     */
+    QList<Run> runs() const;
+
+    /*!
+     * Returns an awaitable which reads the data available as soon as there
+     * is any.
+     *
+     * \a maxSize the maximal amount of data to read, or 0 for no limit
+     *
+     * The result is empty at EOF or when the device is closed.
+     *
+     * Awaiting needs C++20 and the KPtyAwaitable header, which this
+     * header does not include.
+     *
+     * \sa KPtyAwaitable
+     * \since 6.28
+     */
+    KPtyAwaitable readSomeAsync(qint64 maxSize = 0);
+
+    /*!
+     * Returns an awaitable which reads a line, including the terminating
+     * newline, as soon as a complete one is available.
+     *
+     * At EOF, the incomplete rest of the data is returned.
+     *
+     * \sa KPtyAwaitable
+     * \since 6.28
+     */
+    KPtyAwaitable readLineAsync();
+
+    /*!
+     * Returns an awaitable which reads the data up to and including
+     * \a delimiter as soon as it is available.
+     *
+     * The data is searched incrementally, so each byte is inspected only
+     * once no matter how many reads it takes until \a delimiter arrives.
+     * At EOF, the rest of the data is returned.
+     *
+     * \sa KPtyAwaitable
+     * \since 6.28
+     */
+    KPtyAwaitable readUntilAsync(const QByteArray &delimiter);
+
+    /*!
+     * Returns an awaitable which completes as soon as all written data
+     * has been passed to the pty.
+     *
+     * \sa KPtyAwaitable
+     * \since 6.28
+     */
+    KPtyAwaitable drainAsync();
+
     /*!
      * Returns always true
      */
@@ -108,6 +875,28 @@ public:
     bool waitForBytesWritten(int msecs = -1) override;
     bool waitForReadyRead(int msecs = -1) override;
 
+    /*!
+     * Block until at least one of \a devices made progress.
+     *
+     * All the devices are waited for in a single poll(), and every device
+     * which becomes ready is serviced as by waitForReadyRead() and
+     * waitForBytesWritten(): its data is read and readyRead() or readEof()
+     * is emitted, and its pending data is written and bytesWritten() is
+     * emitted. This allows a thread without an event loop to drive a
+     * group of devices without round-robin timeouts.
+     *
+     * Suspended devices and devices at EOF are only waited for if they
+     * have data to write; closed devices are ignored.
+     *
+     * \a deadline when to give up
+     *
+     * Returns the devices which read data, reached EOF or wrote data, or
+     *  an empty list on timeout, error, or if there is nothing to wait for
+     *
+     * \since 6.28
+     */
+    static QList<KPtyDevice *> waitForAny(const QList<KPtyDevice *> &devices, QDeadlineTimer deadline = QDeadlineTimer(QDeadlineTimer::Forever));
+
 Q_SIGNALS:
     /*!
      * Emitted when EOF is read from the PTY.
@@ -116,10 +905,81 @@ Q_SIGNALS:
      */
     void readEof();
 
+    /*!
+     * Emitted in packet mode when the slave side suspends its output,
+     * usually because the user typed Ctrl-S.
+     *
+     * \since 6.28
+     */
+    void outputSuspended();
+
+    /*!
+     * Emitted in packet mode when the slave side resumes its output.
+     *
+     * \since 6.28
+     */
+    void outputResumed();
+
+    /*!
+     * Emitted in packet mode when the input written to the pty and not
+     * yet read by the slave side was discarded (TIOCPKT_FLUSHREAD).
+     *
+     * \since 6.28
+     */
+    void inputFlushed();
+
+    /*!
+     * Emitted in packet mode when the output of the slave side which was
+     * not yet read was discarded (TIOCPKT_FLUSHWRITE).
+     *
+     * \since 6.28
+     */
+    void outputFlushed();
+
+    /*!
+     * Emitted in packet mode when the slave side enables or disables
+     * XON/XOFF flow control with the standard stop and start characters.
+     *
+     * \since 6.28
+     */
+    void flowControlChanged(bool enabled);
+
+    /*!
+     * Emitted with the new attributes \a ttmode when the slave side
+     * changed the terminal attributes.
+     *
+     * Requires setTermiosTracking(). Changes made through KPty are not
+     * reported.
+     *
+     * \since 6.28
+     */
+    void termiosChanged(const struct ::termios &ttmode);
+
+    /*!
+     * Emitted when the foreground process group of the pty changed to the
+     * one led by \a pid, called \a name.
+     *
+     * \a pid is -1 if there is no foreground process group anymore.
+     *
+     * Requires setForegroundProcessTracking().
+     *
+     * \since 6.28
+     */
+    void foregroundProcessChanged(qint64 pid, const QString &name);
+
 protected:
     qint64 readData(char *data, qint64 maxSize) override;
     qint64 readLineData(char *data, qint64 maxSize) override;
     qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    friend class KPtyAwaitablePrivate;
+    friend class KPtyExpectPrivate;
+    friend class KPtyProcessPrivate;
+    friend class KPtyReadScheduler;
+    friend class KPtySubscriptionPrivate;
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(KPtyDevice::WriteFlags)
+
 #endif
@@ -0,0 +1,507 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2007 Oswald Buddenhagen <ossi@kde.org>
+    SPDX-FileCopyrightText: 2010 KDE e.V. <kde-ev-board@kde.org>
+    SPDX-FileContributor: 2010 Adriaan de Groot <groot@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef kptydev_p_h
+#define kptydev_p_h
+
+#include "kpty_p.h"
+#include "kptydevice.h"
+#include "kptysharedring_p.h"
+#include "kptytokenizer_p.h"
+
+#include <QByteArray>
+#include <QDeadlineTimer>
+#include <QElapsedTimer>
+#include <QList>
+#include <QString>
+#include <QThread>
+
+#include <sys/ioctl.h>
+#if HAVE_SYS_FILIO_H
+#include <sys/filio.h>
+#endif
+
+class KPtyExpectPrivate;
+class KPtyReadSchedulerPrivate;
+class KPtySubscriptionPrivate;
+class QSocketNotifier;
+class QTimer;
+
+#if defined(Q_OS_FREEBSD) || defined(Q_OS_MAC)
+// "the other end's output queue size" -- that is is our end's input
+#define PTY_BYTES_AVAILABLE TIOCOUTQ
+#elif defined(TIOCINQ)
+// "our end's input queue size"
+#define PTY_BYTES_AVAILABLE TIOCINQ
+#else
+// likewise. more generic ioctl (theoretically)
+#define PTY_BYTES_AVAILABLE FIONREAD
+#endif
+
+#define KMAXINT ((int)(~0U >> 1))
+
+/////////////////////////////////////////////////////
+// Helper. Remove when QRingBuffer becomes public. //
+/////////////////////////////////////////////////////
+
+#define CHUNKSIZE 4096
+
+// the power of two holding size, so chunks fall into few allocator size
+// classes and can be reused for each other
+static inline int chunkSizeClass(int size)
+{
+    int sizeClass = 256;
+    while (sizeClass < size && sizeClass < (1 << 30)) {
+        sizeClass <<= 1;
+    }
+    return sizeClass;
+}
+
+class KRingBuffer
+{
+public:
+    KRingBuffer()
+    {
+        clear();
+    }
+
+    // chunks are only allocated when data is written
+    void clear()
+    {
+        buffers.clear();
+        start = headIndex = head = tail = 0;
+        totalSize = 0;
+        retained = 0;
+    }
+
+    // release the chunk kept around for reuse by an empty buffer
+    void squeeze()
+    {
+        if (!totalSize && !retained) {
+            clear();
+        }
+    }
+
+    // the size of newly allocated chunks; larger reservations get a chunk
+    // of their own size
+    void setChunkSize(int size)
+    {
+        chunkSize = size;
+    }
+
+    inline int currentChunkSize() const
+    {
+        return chunkSize;
+    }
+
+    // Whether free() keeps the data in front of the read position, for
+    // other readers which are behind, until release() drops it.
+    void setRetaining(bool enable)
+    {
+        if (!enable) {
+            release(retained);
+        }
+        retaining = enable;
+    }
+
+    // the amount of data kept in front of the read position
+    inline int retainedSize() const
+    {
+        return retained;
+    }
+
+    inline bool isEmpty() const
+    {
+        return !totalSize;
+    }
+
+    inline int size() const
+    {
+        return totalSize;
+    }
+
+    inline int readSize() const
+    {
+        if (buffers.isEmpty()) {
+            return 0;
+        }
+        return chunkEnd(headIndex) - head;
+    }
+
+    inline const char *readPointer() const
+    {
+        Q_ASSERT(totalSize > 0);
+        return buffers.at(headIndex).constData() + head;
+    }
+
+    void free(int bytes)
+    {
+        totalSize -= bytes;
+        Q_ASSERT(totalSize >= 0);
+        if (buffers.isEmpty()) {
+            return;
+        }
+
+        advance(headIndex, head, bytes);
+        if (retaining) {
+            retained += bytes;
+        } else {
+            dropChunks(headIndex);
+            start = head;
+        }
+        recycle();
+    }
+
+    // drop the oldest bytes of the retained data
+    void release(int bytes)
+    {
+        retained -= bytes;
+        Q_ASSERT(retained >= 0);
+        if (buffers.isEmpty()) {
+            return;
+        }
+
+        int index = 0;
+        advance(index, start, bytes);
+        if (index > headIndex) {
+            // the same position, at the end of the chunk before
+            index = headIndex;
+            start = head;
+        }
+        dropChunks(index);
+        recycle();
+    }
+
+    char *reserve(int bytes)
+    {
+        totalSize += bytes;
+
+        char *ptr;
+        if (buffers.isEmpty()) {
+            QByteArray tmp;
+            tmp.resize(qMax(chunkSize, bytes));
+            ptr = tmp.data();
+            buffers << tmp;
+            tail = bytes;
+        } else if (tail + bytes <= buffers.last().size()) {
+            ptr = buffers.last().data() + tail;
+            tail += bytes;
+        } else {
+            buffers.last().resize(tail);
+            QByteArray tmp;
+            tmp.resize(qMax(chunkSize, bytes));
+            ptr = tmp.data();
+            buffers << tmp;
+            tail = bytes;
+        }
+        return ptr;
+    }
+
+    // release a trailing part of the last reservation
+    inline void unreserve(int bytes)
+    {
+        totalSize -= bytes;
+        tail -= bytes;
+    }
+
+    inline void write(const char *data, int len)
+    {
+        memcpy(reserve(len), data, len);
+    }
+
+    // Find the first occurrence of c and return the index after it.
+    // If c is not found until maxLength, maxLength is returned, provided
+    // it is smaller than the buffer size. Otherwise -1 is returned.
+    int indexAfter(char c, int maxLength = KMAXINT) const
+    {
+        int index = 0;
+        int offset = head;
+        QList<QByteArray>::ConstIterator it = buffers.begin() + headIndex;
+        for (;;) {
+            if (!maxLength) {
+                return index;
+            }
+            if (index == size()) {
+                return -1;
+            }
+            const QByteArray &buf = *it;
+            ++it;
+            int len = qMin((it == buffers.end() ? tail : buf.size()) - offset, maxLength);
+            const char *ptr = buf.data() + offset;
+            if (const char *rptr = (const char *)memchr(ptr, c, len)) {
+                return index + (rptr - ptr) + 1;
+            }
+            index += len;
+            maxLength -= len;
+            offset = 0;
+        }
+    }
+
+    // Call f(data, size) for the consecutive pieces of the buffer
+    // following index from, until it returns false.
+    template<typename F>
+    void forEachChunk(int from, F f) const
+    {
+        forEachChunk(headIndex, head, from, f);
+    }
+
+    // Likewise, but from is counted from the start of the retained data.
+    template<typename F>
+    void forEachRetainedChunk(int from, F f) const
+    {
+        forEachChunk(0, start, from, f);
+    }
+
+    inline int lineSize(int maxLength = KMAXINT) const
+    {
+        return indexAfter('\n', maxLength);
+    }
+
+    inline bool canReadLine() const
+    {
+        return lineSize() != -1;
+    }
+
+    int read(char *data, int maxLength)
+    {
+        int bytesToRead = qMin(size(), maxLength);
+        int readSoFar = 0;
+        while (readSoFar < bytesToRead) {
+            const char *ptr = readPointer();
+            int bs = qMin(bytesToRead - readSoFar, readSize());
+            memcpy(data + readSoFar, ptr, bs);
+            readSoFar += bs;
+            free(bs);
+        }
+        return readSoFar;
+    }
+
+    int readLine(char *data, int maxLength)
+    {
+        return read(data, lineSize(qMin(maxLength, size())));
+    }
+
+private:
+    inline int chunkEnd(int index) const
+    {
+        return index == buffers.count() - 1 ? tail : buffers.at(index).size();
+    }
+
+    // move the position in the chunk at index forward by bytes
+    void advance(int &index, int &offset, int bytes) const
+    {
+        while (index < buffers.count() - 1 && bytes >= chunkEnd(index) - offset) {
+            bytes -= chunkEnd(index) - offset;
+            ++index;
+            offset = 0;
+        }
+        offset += bytes;
+    }
+
+    void dropChunks(int count)
+    {
+        if (count) {
+            buffers.remove(0, count);
+            headIndex -= count;
+        }
+    }
+
+    // an empty buffer starts over in the last chunk
+    void recycle()
+    {
+        if (!totalSize && !retained) {
+            buffers.remove(0, buffers.count() - 1);
+            buffers.first().resize(chunkSize);
+            start = headIndex = head = tail = 0;
+        }
+    }
+
+    template<typename F>
+    void forEachChunk(int index, int offset, int from, F f) const
+    {
+        for (int i = index; i < buffers.count(); ++i) {
+            const int len = chunkEnd(i) - offset;
+            if (from < len) {
+                if (!f(buffers.at(i).constData() + offset + from, len - from)) {
+                    return;
+                }
+                from = 0;
+            } else {
+                from -= len;
+            }
+            offset = 0;
+        }
+    }
+
+    QList<QByteArray> buffers;
+    int start; // the retained data starts here in the first chunk
+    int headIndex, head; // the read position
+    int tail;
+    int totalSize;
+    int retained;
+    bool retaining = false;
+    int chunkSize = CHUNKSIZE;
+};
+
+//////////////////
+// private data //
+//////////////////
+
+class KPtyDevicePrivate : public KPtyPrivate
+{
+    Q_DECLARE_PUBLIC(KPtyDevice)
+public:
+    KPtyDevicePrivate(KPty *parent)
+        : KPtyPrivate(parent)
+        , emittedReadyRead(false)
+        , emittedBytesWritten(false)
+        , readNotifier(nullptr)
+        , writeNotifier(nullptr)
+    {
+    }
+
+    bool _k_canRead(int limit = KMAXINT);
+    bool _k_canWrite();
+
+    // the device must only be used from the thread it lives in
+    void assertThread() const
+    {
+        Q_ASSERT_X(q_func()->thread() == QThread::currentThread(), "KPtyDevice", "device used from a thread other than its own");
+    }
+
+    bool doWait(int msecs, bool reading);
+    void finishOpen(QIODevice::OpenMode mode);
+
+    // stream offset of the first byte in readBuffer
+    qint64 readBufferHead() const
+    {
+        return readBufferEnd - readBuffer.size();
+    }
+
+    // stream offset of the first byte kept in readBuffer for subscriptions
+    qint64 retainedHead() const
+    {
+        return readBufferHead() - readBuffer.retainedSize();
+    }
+
+    void trimFanout();
+    void feedSubscriptions();
+    // continue at the stream offset offset, with an empty readBuffer
+    void rebaseStream(qint64 offset);
+    void discardReadBuffer();
+    int completeUtf8Size(int maxSize) const;
+    void checkSharedRingSpace();
+
+    // a reader which can't keep up holds back reading from the pty
+    bool readersLagging() const
+    {
+        return fanoutBlocked || sharedRingBlocked;
+    }
+
+    bool hasPendingWrites() const
+    {
+        return !urgentBuffer.isEmpty() || !writeBuffer.isEmpty();
+    }
+
+#ifdef TIOCPKT
+    void handlePacket(int status);
+#endif
+    void enableWriteNotifier();
+    void noteActivity();
+    void checkIdle();
+    void adaptReadChunkSize(int wanted);
+    void setReadChunkSize(int size);
+    void startWinSizeTimer(QTimer *&timer, int msecs);
+    void foregroundMayHaveChanged();
+    void updateForegroundProcess(bool notify);
+    void updateReadNotifier();
+    qint64 availableTokens();
+    void throttle(qint64 wanted);
+    void unthrottle();
+
+    bool emittedReadyRead;
+    bool emittedBytesWritten;
+    bool suspended = false;
+    bool eof = false;
+    QSocketNotifier *readNotifier;
+    QSocketNotifier *writeNotifier;
+
+    // releasing the resources of idle devices
+    int idleReleaseTimeout = -1;
+    QTimer *idleTimer = nullptr;
+    bool activeSinceIdleCheck = false;
+
+    // chunk size of readBuffer, following the size of the reads
+    int readChunkMinimum = CHUNKSIZE;
+    int readChunkMaximum = 16 * CHUNKSIZE;
+    int smallReads = 0; // in a row, well below the chunk size
+
+    // token bucket limiting the read rate
+    qint64 readRateLimit = 0;
+    qint64 readBurst = 0;
+    double tokens = 0;
+    QElapsedTimer tokenClock;
+    bool throttled = false;
+    QDeadlineTimer throttleDeadline;
+    QElapsedTimer throttleClock;
+    QTimer *throttleTimer = nullptr;
+
+    // TIOCPKT
+    bool packetMode = false;
+    bool outputSuspended = false;
+
+    // coalesced window size changes
+    int winSizeQuietPeriod = 0;
+    int winSizeMaxDelay = -1;
+    int requestedWinSize[4] = {};
+    bool winSizeRequested = false;
+    QTimer *winSizeQuietTimer = nullptr;
+    QTimer *winSizeMaxDelayTimer = nullptr;
+
+    // cached foreground process group
+    int foregroundCheckDelay = -1; // disabled
+    QTimer *foregroundTimer = nullptr;
+    qint64 foregroundPid = -1;
+    QString foregroundName;
+
+    // deficit round-robin scheduling
+    KPtyReadSchedulerPrivate *scheduler = nullptr;
+    bool scheduled = false;
+    qint64 deficit = 0;
+
+    // matchers fed with every read
+    QList<KPtyExpectPrivate *> expects;
+
+    // readers sharing readBuffer with the device, which keeps the output
+    // the device consumed until the slowest of them read it
+    QList<KPtySubscriptionPrivate *> subscriptions;
+    bool fanoutBlocked = false;
+
+    // consumer memory replacing readBuffer, see setReadSink()
+    std::function<QSpan<char>(qsizetype)> readSinkAcquire;
+    std::function<void(QSpan<char>)> readSinkCommit;
+
+    // runs of text and control sequences, see setTokenizing()
+    std::unique_ptr<KPtyTokenizer> tokenizer;
+
+    // output exported to another process
+    std::unique_ptr<KPtySharedRingWriter> sharedRing;
+    QSocketNotifier *sharedRingNotifier = nullptr;
+    bool sharedRingBlocked = false;
+
+    KPtyDevice::Statistics stats;
+    KPtyHistory *history = nullptr;
+    KPtyRetentionBuffer *retentionBuffer = nullptr;
+    KRingBuffer readBuffer;
+    qint64 readBufferEnd = 0; // stream offset following the last byte in readBuffer
+    KRingBuffer writeBuffer;
+    KRingBuffer urgentBuffer; // flushed ahead of writeBuffer
+};
+
+#endif
@@ -0,0 +1,474 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kptyexpect_p.h"
+#include "kptydevice_p.h"
+
+#include <QDeadlineTimer>
+#include <QTimer>
+
+#include <utility>
+
+//////////////////
+// private data //
+//////////////////
+
+KPtyDevicePrivate *KPtyExpectPrivate::devicePrivate() const
+{
+    return device->d_func();
+}
+
+void KPtyExpectPrivate::buildAutomaton()
+{
+    automatonDirty = false;
+    state = 0;
+
+    // the trie of all literals
+    transitions.fill(-1, 256);
+    output = {-1};
+    for (int i = 0; i < patterns.size(); ++i) {
+        const Pattern &pattern = patterns.at(i);
+        if (pattern.isRegex || pattern.literal.isEmpty()) {
+            continue;
+        }
+        int s = 0;
+        for (char c : pattern.literal) {
+            const int index = s * 256 + uchar(c);
+            if (transitions.at(index) < 0) {
+                transitions[index] = output.size();
+                transitions.resize(transitions.size() + 256, -1);
+                output.append(-1);
+            }
+            s = transitions.at(index);
+        }
+        if (output.at(s) < 0) {
+            output[s] = i;
+        }
+    }
+
+    // breadth-first, turn failure links into direct transitions
+    QList<int> failure(output.size(), 0);
+    QList<int> queue;
+    for (int c = 0; c < 256; ++c) {
+        if (transitions.at(c) < 0) {
+            transitions[c] = 0;
+        } else {
+            queue.append(transitions.at(c));
+        }
+    }
+    for (qsizetype i = 0; i < queue.size(); ++i) {
+        const int s = queue.at(i);
+        for (int c = 0; c < 256; ++c) {
+            const int t = transitions.at(s * 256 + c);
+            const int fallback = transitions.at(failure.at(s) * 256 + c);
+            if (t < 0) {
+                transitions[s * 256 + c] = fallback;
+                continue;
+            }
+            failure[t] = fallback;
+            // a shorter pattern ending here may have been added earlier
+            const int inherited = output.at(fallback);
+            if (inherited >= 0 && (output.at(t) < 0 || inherited < output.at(t))) {
+                output[t] = inherited;
+            }
+            queue.append(t);
+        }
+    }
+}
+
+void KPtyExpectPrivate::appendDecoded(char32_t codePoint, int size)
+{
+    if (QChar::requiresSurrogates(codePoint)) {
+        window.append(QChar(QChar::highSurrogate(codePoint)));
+        window.append(QChar(QChar::lowSurrogate(codePoint)));
+        unitSizes.append(char(size));
+        unitSizes.append(char(0));
+    } else {
+        window.append(QChar(char16_t(codePoint)));
+        unitSizes.append(char(size));
+    }
+}
+
+// Each invalid byte stands for a replacement character of its own.
+void KPtyExpectPrivate::appendInvalid(int size)
+{
+    for (int i = 0; i < size; ++i) {
+        appendDecoded(QChar::ReplacementCharacter, 1);
+    }
+}
+
+void KPtyExpectPrivate::decodeByte(uchar c)
+{
+    if (pendingLength) {
+        if ((c & 0xc0) == 0x80) {
+            pendingCodePoint = (pendingCodePoint << 6) | (c & 0x3f);
+            if (++pendingSize < pendingLength) {
+                return;
+            }
+            static const char32_t minimum[] = {0, 0, 0x80, 0x800, 0x10000};
+            const int size = std::exchange(pendingSize, 0);
+            pendingLength = 0;
+            if (pendingCodePoint < minimum[size] || pendingCodePoint > QChar::LastValidCodePoint || QChar::isSurrogate(pendingCodePoint)) {
+                appendInvalid(size);
+            } else {
+                appendDecoded(pendingCodePoint, size);
+            }
+            return;
+        }
+        // the sequence was cut short, and c starts over
+        appendInvalid(std::exchange(pendingSize, 0));
+        pendingLength = 0;
+    }
+
+    if (c < 0x80) {
+        appendDecoded(c, 1);
+        return;
+    }
+    if ((c & 0xe0) == 0xc0) {
+        pendingCodePoint = c & 0x1f;
+        pendingLength = 2;
+    } else if ((c & 0xf0) == 0xe0) {
+        pendingCodePoint = c & 0x0f;
+        pendingLength = 3;
+    } else if ((c & 0xf8) == 0xf0) {
+        pendingCodePoint = c & 0x07;
+        pendingLength = 4;
+    } else {
+        appendInvalid(1);
+        return;
+    }
+    pendingSize = 1;
+}
+
+void KPtyExpectPrivate::decodeWindow(qint64 head, qint64 end)
+{
+    if (decodedEnd >= end) {
+        return;
+    }
+    devicePrivate()->readBuffer.forEachChunk(int(decodedEnd - head), [this](const char *data, int size) {
+        for (int i = 0; i < size; ++i) {
+            decodeByte(uchar(data[i]));
+        }
+        return true;
+    });
+    decodedEnd = end;
+}
+
+qint64 KPtyExpectPrivate::windowBytes(qsizetype units) const
+{
+    qint64 bytes = 0;
+    for (qsizetype i = 0; i < units; ++i) {
+        bytes += unitSizes.at(i);
+    }
+    return bytes;
+}
+
+// The units standing for at most bytes bytes; a surrogate pair is never split.
+qsizetype KPtyExpectPrivate::windowUnits(qint64 bytes, bool *exact) const
+{
+    qsizetype units = 0;
+    qint64 size = 0;
+    while (units < unitSizes.size() && size + unitSizes.at(units) <= bytes) {
+        size += unitSizes.at(units++);
+    }
+    if (exact) {
+        *exact = size == bytes;
+    }
+    return units;
+}
+
+void KPtyExpectPrivate::dropWindow(qsizetype units)
+{
+    regexStart += windowBytes(units);
+    window.remove(0, units);
+    unitSizes.remove(0, units);
+}
+
+void KPtyExpectPrivate::resetWindow(qint64 offset)
+{
+    regexStart = decodedEnd = offset;
+    window.clear();
+    unitSizes.clear();
+    pendingSize = pendingLength = 0;
+}
+
+// Let the window start at offset, keeping what was decoded if it falls on a character boundary.
+void KPtyExpectPrivate::moveWindow(qint64 offset)
+{
+    bool exact = false;
+    const qsizetype units = windowUnits(offset - regexStart, &exact);
+    if (exact) {
+        dropWindow(units);
+    } else {
+        resetWindow(offset);
+    }
+}
+
+bool KPtyExpectPrivate::findMatch()
+{
+    KPtyDevicePrivate *dd = devicePrivate();
+    const qint64 head = dd->readBufferHead();
+    const qint64 end = dd->readBufferEnd;
+
+    // the application may have consumed output we did not see yet
+    if (scanned < head) {
+        scanned = head;
+        state = 0;
+    }
+    if (regexStart < head) {
+        resetWindow(head);
+    }
+    if (automatonDirty) {
+        buildAutomaton();
+    }
+
+    KPtyExpect::Match match;
+    if (hasLiterals) {
+        dd->readBuffer.forEachChunk(int(scanned - head), [this, &match](const char *data, int size) {
+            for (int i = 0; i < size; ++i) {
+                state = transitions.at(state * 256 + uchar(data[i]));
+                if (output.at(state) >= 0) {
+                    scanned += i + 1;
+                    match.pattern = output.at(state);
+                    match.length = patterns.at(match.pattern).literal.size();
+                    match.offset = scanned - match.length;
+                    return false;
+                }
+            }
+            scanned += size;
+            return true;
+        });
+    } else {
+        scanned = end;
+    }
+
+    if (hasRegexes) {
+        decodeWindow(head, end);
+
+        // regular expressions only need to look up to the end of a literal match
+        const qsizetype units = match.pattern >= 0 ? windowUnits(scanned - regexStart) : window.size();
+        const QStringView text = QStringView(window).first(units);
+
+        qsizetype keep = units;
+        for (int i = 0; i < patterns.size(); ++i) {
+            const Pattern &pattern = patterns.at(i);
+            if (!pattern.isRegex || text.isEmpty()) {
+                continue;
+            }
+            const QRegularExpressionMatch m = pattern.regex.matchView(text, 0, QRegularExpression::PartialPreferCompleteMatch);
+            if (m.hasMatch() && m.capturedLength()) {
+                const qint64 matchEnd = regexStart + windowBytes(m.capturedEnd());
+                const qint64 bestEnd = match.offset + match.length;
+                if (match.pattern < 0 || matchEnd < bestEnd || (matchEnd == bestEnd && i < match.pattern)) {
+                    match.pattern = i;
+                    match.offset = regexStart + windowBytes(m.capturedStart());
+                    match.length = matchEnd - match.offset;
+                }
+            } else if (m.hasPartialMatch()) {
+                keep = qMin(keep, m.capturedStart());
+            }
+        }
+        if (match.pattern < 0) {
+            dropWindow(keep);
+        }
+    }
+
+    if (match.pattern < 0) {
+        return false;
+    }
+
+    scanned = match.offset + match.length;
+    moveWindow(scanned);
+    state = 0;
+    lastMatch = match;
+    matchCount++;
+    return true;
+}
+
+void KPtyExpectPrivate::scan()
+{
+    Q_Q(KPtyExpect);
+
+    if (!active || !device || !findMatch()) {
+        return;
+    }
+    restartTimer();
+    QPointer<KPtyExpect> guard(q);
+    Q_EMIT q->matched(lastMatch.pattern, lastMatch.offset, lastMatch.length);
+    // one match at a time, so waitForMatch() and lastMatch() see each of them
+    if (guard) {
+        postScan();
+    }
+}
+
+void KPtyExpectPrivate::postScan()
+{
+    Q_Q(KPtyExpect);
+
+    if (scanPending || !active) {
+        return;
+    }
+    scanPending = true;
+    QMetaObject::invokeMethod(
+        q,
+        [this]() {
+            scanPending = false;
+            scan();
+        },
+        Qt::QueuedConnection);
+}
+
+void KPtyExpectPrivate::restartTimer()
+{
+    if (timeout >= 0 && active) {
+        timer->start(timeout);
+    } else {
+        timer->stop();
+    }
+}
+
+/////////////////////////////
+// public member functions //
+/////////////////////////////
+
+KPtyExpect::KPtyExpect(KPtyDevice *device, QObject *parent)
+    : QObject(parent)
+    , d_ptr(new KPtyExpectPrivate(this, device))
+{
+    Q_D(KPtyExpect);
+
+    d->timer = new QTimer(this);
+    d->timer->setSingleShot(true);
+    connect(d->timer, &QTimer::timeout, this, &KPtyExpect::timedOut);
+}
+
+KPtyExpect::~KPtyExpect()
+{
+    stop();
+}
+
+int KPtyExpect::addPattern(const QByteArray &literal)
+{
+    Q_D(KPtyExpect);
+
+    d->patterns.append({literal, QRegularExpression(), false});
+    d->hasLiterals = true;
+    d->automatonDirty = true;
+    return d->patterns.size() - 1;
+}
+
+int KPtyExpect::addPattern(const QRegularExpression &regex)
+{
+    Q_D(KPtyExpect);
+
+    d->patterns.append({QByteArray(), regex, true});
+    d->hasRegexes = true;
+    return d->patterns.size() - 1;
+}
+
+void KPtyExpect::clearPatterns()
+{
+    Q_D(KPtyExpect);
+
+    d->patterns.clear();
+    d->hasLiterals = false;
+    d->hasRegexes = false;
+    d->automatonDirty = true;
+}
+
+void KPtyExpect::setTimeout(int msecs)
+{
+    Q_D(KPtyExpect);
+
+    d->timeout = msecs;
+    d->restartTimer();
+}
+
+int KPtyExpect::timeout() const
+{
+    Q_D(const KPtyExpect);
+
+    return d->timeout;
+}
+
+void KPtyExpect::start()
+{
+    Q_D(KPtyExpect);
+
+    if (d->active || !d->device) {
+        return;
+    }
+    d->active = true;
+
+    KPtyDevicePrivate *dd = d->devicePrivate();
+    dd->expects.append(d);
+    d->scanned = dd->readBufferHead();
+    d->resetWindow(d->scanned);
+    d->state = 0;
+    d->restartTimer();
+
+    // the output already buffered is matched from the event loop
+    d->postScan();
+}
+
+void KPtyExpect::stop()
+{
+    Q_D(KPtyExpect);
+
+    if (!d->active) {
+        return;
+    }
+    d->active = false;
+    d->timer->stop();
+    if (d->device) {
+        d->devicePrivate()->expects.removeOne(d);
+    }
+}
+
+bool KPtyExpect::isActive() const
+{
+    Q_D(const KPtyExpect);
+
+    return d->active;
+}
+
+bool KPtyExpect::waitForMatch(int msecs)
+{
+    Q_D(KPtyExpect);
+
+    start();
+    const qint64 before = d->matchCount;
+    d->scan();
+
+    const QDeadlineTimer deadline(msecs, Qt::PreciseTimer);
+    while (d->matchCount == before) {
+        if (!d->device || !d->device->waitForReadyRead(int(deadline.remainingTime()))) {
+            return d->matchCount != before;
+        }
+    }
+    return true;
+}
+
+KPtyExpect::Match KPtyExpect::lastMatch() const
+{
+    Q_D(const KPtyExpect);
+
+    return d->lastMatch;
+}
+
+QByteArray KPtyExpect::readThroughMatch()
+{
+    Q_D(KPtyExpect);
+
+    if (!d->device || d->lastMatch.pattern < 0) {
+        return QByteArray();
+    }
+    const qint64 size = d->lastMatch.offset + d->lastMatch.length - d->devicePrivate()->readBufferHead();
+    return size > 0 ? d->device->read(size) : QByteArray();
+}
+
+#include "moc_kptyexpect.cpp"
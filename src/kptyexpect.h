@@ -0,0 +1,187 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef kptyexpect_h
+#define kptyexpect_h
+
+#include "kpty_export.h"
+
+#include <QByteArray>
+#include <QObject>
+
+#include <memory>
+
+class KPtyDevice;
+class KPtyExpectPrivate;
+class QRegularExpression;
+
+/*!
+ * \class KPtyExpect
+ * \inmodule KPty
+ *
+ * \brief Waits for any of a set of patterns to appear in the output of a
+ * KPtyDevice.
+ *
+ * The matcher inspects the output right after it is read from the pty,
+ * before readyRead() is emitted, in place in the device's read buffer.
+ * Literal patterns are combined into a single Aho-Corasick automaton, so
+ * each byte is inspected once, no matter how many patterns there are and
+ * how many reads it takes until one of them is complete.
+ *
+ * Regular expressions are supported as well. They operate on the output
+ * decoded as UTF-8, with each invalid byte standing for a U+FFFD
+ * replacement character; match offsets and lengths are still in bytes.
+ * As a regular expression can't be matched in place, the output is decoded
+ * into a window once, as it arrives. Partial matching limits the window to
+ * the output following the start of the last incomplete match, but every
+ * scan runs the expressions over all of it again, so an expression that
+ * keeps matching partially over a lot of output gets slower with each read.
+ *
+ * The earliest ending match is reported; if several patterns end at the
+ * same position, the one added first wins. Scanning then resumes right
+ * after the match, so the same output is never matched twice. Further
+ * matches in output which was already read are reported from the event
+ * loop, or by the next waitForMatch(). The output itself stays in the
+ * device for the application to read, e.g. with readThroughMatch().
+ *
+ * Matches are located by stream offsets, which count the bytes read from
+ * the pty since the device was created.
+ *
+ * \since 6.28
+ */
+class KPTY_EXPORT KPtyExpect : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(KPtyExpect)
+
+public:
+    /*!
+     * \class KPtyExpect::Match
+     * \inmodule KPty
+     *
+     * \brief The location of a match.
+     */
+    struct Match {
+        /*!
+         * \variable KPtyExpect::Match::pattern
+         * The index of the matching pattern, or -1 if there was no match
+         */
+        int pattern = -1;
+        /*!
+         * \variable KPtyExpect::Match::offset
+         * The stream offset of the start of the match
+         */
+        qint64 offset = -1;
+        /*!
+         * \variable KPtyExpect::Match::length
+         * The length of the match
+         */
+        qint64 length = 0;
+    };
+
+    /*!
+     * Constructor
+     *
+     * \a device the device whose output is matched
+     *
+     * \a parent the parent object
+     */
+    explicit KPtyExpect(KPtyDevice *device, QObject *parent = nullptr);
+
+    /*!
+     * Destructor
+     */
+    ~KPtyExpect() override;
+
+    /*!
+     * Add a literal pattern.
+     *
+     * Returns the index of the pattern
+     */
+    int addPattern(const QByteArray &literal);
+
+    /*!
+     * Add a regular expression pattern.
+     *
+     * Returns the index of the pattern
+     */
+    int addPattern(const QRegularExpression &regex);
+
+    /*!
+     * Remove all patterns.
+     */
+    void clearPatterns();
+
+    /*!
+     * Set the time to wait for a match, in milliseconds.
+     *
+     * The time starts anew with start() and after each match. When it
+     * expires, timedOut() is emitted. -1, the default, disables the
+     * timeout.
+     */
+    void setTimeout(int msecs);
+
+    /*!
+     * Returns the time to wait for a match, in milliseconds
+     */
+    int timeout() const;
+
+    /*!
+     * Start matching the output which was not consumed from the device
+     * yet, including the output which is already buffered.
+     */
+    void start();
+
+    /*!
+     * Stop matching.
+     */
+    void stop();
+
+    /*!
+     * Returns true if the output is being matched
+     */
+    bool isActive() const;
+
+    /*!
+     * Block until a match is found.
+     *
+     * Matching is started if needed.
+     *
+     * Returns true if a match was found, false on timeout or EOF
+     */
+    bool waitForMatch(int msecs = 30000);
+
+    /*!
+     * Returns the most recent match
+     */
+    Match lastMatch() const;
+
+    /*!
+     * Read the output from the device up to the end of the most recent
+     * match.
+     *
+     * Returns the output, or an empty array if the match was already read
+     */
+    QByteArray readThroughMatch();
+
+Q_SIGNALS:
+    /*!
+     * Emitted when \a pattern matched the \a length bytes starting at
+     * the stream offset \a offset.
+     */
+    void matched(int pattern, qint64 offset, qint64 length);
+
+    /*!
+     * Emitted when no match was found within timeout().
+     */
+    void timedOut();
+
+private:
+    std::unique_ptr<KPtyExpectPrivate> const d_ptr;
+};
+
+#endif
@@ -0,0 +1,88 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef kptyexpect_p_h
+#define kptyexpect_p_h
+
+#include "kptydevice.h"
+#include "kptyexpect.h"
+
+#include <QList>
+#include <QPointer>
+#include <QRegularExpression>
+
+class KPtyDevicePrivate;
+class QTimer;
+
+class KPtyExpectPrivate
+{
+    Q_DECLARE_PUBLIC(KPtyExpect)
+
+public:
+    struct Pattern {
+        QByteArray literal;
+        QRegularExpression regex;
+        bool isRegex;
+    };
+
+    KPtyExpectPrivate(KPtyExpect *parent, KPtyDevice *dev)
+        : q_ptr(parent)
+        , device(dev)
+    {
+    }
+
+    KPtyDevicePrivate *devicePrivate() const;
+
+    void buildAutomaton();
+    void appendDecoded(char32_t codePoint, int size);
+    void appendInvalid(int size);
+    void decodeByte(uchar c);
+    void decodeWindow(qint64 head, qint64 end);
+    qint64 windowBytes(qsizetype units) const;
+    qsizetype windowUnits(qint64 bytes, bool *exact = nullptr) const;
+    void dropWindow(qsizetype units);
+    void resetWindow(qint64 offset);
+    void moveWindow(qint64 offset);
+    bool findMatch();
+    void scan();
+    void postScan();
+    void restartTimer();
+
+    KPtyExpect *q_ptr;
+    QPointer<KPtyDevice> device;
+    QList<Pattern> patterns;
+    bool hasLiterals = false;
+    bool hasRegexes = false;
+
+    // Aho-Corasick automaton with complete transitions, 256 per state
+    bool automatonDirty = true;
+    QList<int> transitions;
+    QList<int> output; // the first added pattern ending in each state, or -1
+    int state = 0;
+
+    bool active = false;
+    bool scanPending = false;
+    qint64 scanned = 0; // stream offset up to which the automaton was fed
+    qint64 regexStart = 0; // stream offset where regex matching resumes
+
+    // the output from regexStart on, decoded as UTF-8 only once, as regular
+    // expressions can't be matched in place
+    QString window;
+    QByteArray unitSizes; // the number of bytes each unit of window stands for
+    qint64 decodedEnd = 0; // stream offset up to which the output was decoded
+    char32_t pendingCodePoint = 0; // a sequence which is not complete yet
+    int pendingSize = 0;
+    int pendingLength = 0;
+
+    KPtyExpect::Match lastMatch;
+    qint64 matchCount = 0;
+
+    int timeout = -1;
+    QTimer *timer = nullptr;
+};
+
+#endif
@@ -0,0 +1,463 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kptyhistory.h"
+
+#include <kpty_debug.h>
+
+#include <QDir>
+#include <QFile>
+#include <QList>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Every INDEX_STRIDE-th line start of a segment is recorded in its index.
+#define INDEX_STRIDE 256
+
+/* clang-format off */
+#define NO_INTR(ret, func) \
+    do { \
+        ret = func; \
+    } while (ret < 0 && errno == EINTR)
+/* clang-format on */
+
+//////////////////
+// private data //
+//////////////////
+
+struct KPtyHistorySegment {
+    struct IndexEntry {
+        qint64 line; // number of the line starting at pos
+        qint64 pos; // relative to the segment start
+    };
+
+    int fd = -1;
+    char *map = nullptr;
+    qint64 startOffset = 0;
+    qint64 startLine = 0; // number of newlines before startOffset
+    qint64 used = 0;
+    qint64 newlines = 0;
+    bool startsLine = true; // whether a line starts at startOffset
+    QList<IndexEntry> index;
+};
+
+class KPtyHistoryPrivate
+{
+public:
+    KPtyHistoryPrivate(qint64 segSize, int resident)
+        : segmentSize(segSize)
+        , residentSegments(qMax(1, resident))
+    {
+        const qint64 pageSize = sysconf(_SC_PAGESIZE);
+        segmentSize = qMax(pageSize, (segmentSize + pageSize - 1) / pageSize * pageSize);
+    }
+
+    bool addSegment();
+    void dropSegment();
+    char *mapSegment(int idx) const;
+    void unmapSegment(KPtyHistorySegment &seg) const;
+    int segmentForOffset(qint64 offset) const;
+    void enforceRetention();
+
+    qint64 segmentSize;
+    int residentSegments;
+    KPtyHistory::RetentionPolicy policy = KPtyHistory::KeepAll;
+    qint64 maximumSize = 0;
+    QByteArray directory;
+    bool isOpen = false;
+    bool endsWithNewline = false;
+
+    // mutable, as reads map segments on demand
+    mutable QList<KPtyHistorySegment> segments;
+    // ids (droppedSegments + index) of the mapped segments,
+    // most recently used last
+    mutable QList<qint64> mapped;
+    qint64 droppedSegments = 0;
+};
+
+void KPtyHistoryPrivate::unmapSegment(KPtyHistorySegment &seg) const
+{
+    if (seg.map) {
+        munmap(seg.map, segmentSize);
+        seg.map = nullptr;
+    }
+}
+
+char *KPtyHistoryPrivate::mapSegment(int idx) const
+{
+    KPtyHistorySegment &seg = segments[idx];
+    const qint64 id = droppedSegments + idx;
+
+    if (seg.map) {
+        mapped.removeOne(id);
+        mapped.append(id);
+        return seg.map;
+    }
+
+    // Evict the least recently used segment, but never the one written to.
+    const qint64 tailId = droppedSegments + segments.size() - 1;
+    while (mapped.size() >= residentSegments) {
+        auto victim = std::find_if(mapped.begin(), mapped.end(), [tailId](qint64 m) {
+            return m != tailId;
+        });
+        if (victim == mapped.end()) {
+            break;
+        }
+        unmapSegment(segments[*victim - droppedSegments]);
+        mapped.erase(victim);
+    }
+
+    void *ptr = mmap(nullptr, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, seg.fd, 0);
+    if (ptr == MAP_FAILED) {
+        qCWarning(KPTY_LOG) << "Can't map history segment:" << strerror(errno);
+        return nullptr;
+    }
+    seg.map = static_cast<char *>(ptr);
+    mapped.append(id);
+    return seg.map;
+}
+
+bool KPtyHistoryPrivate::addSegment()
+{
+    QByteArray path = directory + "/kpty-history-XXXXXX";
+    int fd = mkstemp(path.data());
+    if (fd < 0) {
+        qCWarning(KPTY_LOG) << "Can't create history segment in" << directory << ":" << strerror(errno);
+        return false;
+    }
+    unlink(path.constData());
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    int ret;
+    NO_INTR(ret, ftruncate(fd, segmentSize));
+    if (ret < 0) {
+        qCWarning(KPTY_LOG) << "Can't size history segment:" << strerror(errno);
+        ::close(fd);
+        return false;
+    }
+
+    KPtyHistorySegment seg;
+    seg.fd = fd;
+    if (!segments.isEmpty()) {
+        const KPtyHistorySegment &last = segments.last();
+        seg.startOffset = last.startOffset + last.used;
+        seg.startLine = last.startLine + last.newlines;
+        seg.startsLine = endsWithNewline;
+    }
+    segments.append(seg);
+
+    if (!mapSegment(segments.size() - 1)) {
+        ::close(fd);
+        segments.removeLast();
+        return false;
+    }
+    return true;
+}
+
+void KPtyHistoryPrivate::dropSegment()
+{
+    KPtyHistorySegment &seg = segments.first();
+    unmapSegment(seg);
+    mapped.removeOne(droppedSegments);
+    ::close(seg.fd);
+    segments.removeFirst();
+    droppedSegments++;
+}
+
+int KPtyHistoryPrivate::segmentForOffset(qint64 offset) const
+{
+    auto it = std::upper_bound(segments.cbegin(), segments.cend(), offset, [](qint64 off, const KPtyHistorySegment &seg) {
+        return off < seg.startOffset;
+    });
+    if (it == segments.cbegin()) {
+        return -1;
+    }
+    --it;
+    if (offset >= it->startOffset + it->used) {
+        return -1;
+    }
+    return it - segments.cbegin();
+}
+
+void KPtyHistoryPrivate::enforceRetention()
+{
+    if (policy != KPtyHistory::DropOldest) {
+        return;
+    }
+    const qint64 end = segments.last().startOffset + segments.last().used;
+    // the segment being written to is never dropped
+    while (segments.size() > 1 && end - segments.at(1).startOffset >= maximumSize) {
+        dropSegment();
+    }
+}
+
+/////////////////////////////
+// public member functions //
+/////////////////////////////
+
+KPtyHistory::KPtyHistory(qint64 segmentSize, int residentSegments)
+    : d_ptr(new KPtyHistoryPrivate(segmentSize, residentSegments))
+{
+}
+
+KPtyHistory::~KPtyHistory()
+{
+    close();
+}
+
+bool KPtyHistory::open(const QString &directory)
+{
+    Q_D(KPtyHistory);
+
+    if (d->isOpen) {
+        return true;
+    }
+
+    QString path = directory;
+    if (path.isEmpty()) {
+        // the temporary directory is a tmpfs on many systems, which keeps
+        // the segments in memory after all
+        path = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+        if (path.isEmpty() || !QDir().mkpath(path)) {
+            path = QDir::tempPath();
+        }
+    }
+    d->directory = QFile::encodeName(path);
+    if (!d->addSegment()) {
+        return false;
+    }
+    d->isOpen = true;
+    return true;
+}
+
+void KPtyHistory::close()
+{
+    Q_D(KPtyHistory);
+
+    while (!d->segments.isEmpty()) {
+        d->dropSegment();
+    }
+    d->mapped.clear();
+    d->droppedSegments = 0;
+    d->endsWithNewline = false;
+    d->isOpen = false;
+}
+
+bool KPtyHistory::isOpen() const
+{
+    Q_D(const KPtyHistory);
+
+    return d->isOpen;
+}
+
+void KPtyHistory::setRetentionPolicy(RetentionPolicy policy, qint64 maximumSize)
+{
+    Q_D(KPtyHistory);
+
+    d->policy = policy;
+    d->maximumSize = maximumSize;
+    if (d->isOpen) {
+        d->enforceRetention();
+    }
+}
+
+KPtyHistory::RetentionPolicy KPtyHistory::retentionPolicy() const
+{
+    Q_D(const KPtyHistory);
+
+    return d->policy;
+}
+
+bool KPtyHistory::append(const char *data, qint64 size)
+{
+    Q_D(KPtyHistory);
+
+    if (!d->isOpen) {
+        return false;
+    }
+
+    while (size > 0) {
+        if (d->segments.last().used == d->segmentSize) {
+            if (!d->addSegment()) {
+                return false;
+            }
+            d->enforceRetention();
+        }
+
+        const int idx = d->segments.size() - 1;
+        char *base = d->mapSegment(idx);
+        if (!base) {
+            return false;
+        }
+        KPtyHistorySegment &seg = d->segments[idx];
+        const qint64 len = qMin(size, d->segmentSize - seg.used);
+        char *dst = base + seg.used;
+        memcpy(dst, data, len);
+
+        const char *ptr = dst;
+        const char *end = dst + len;
+        while (const char *nl = static_cast<const char *>(memchr(ptr, '\n', end - ptr))) {
+            seg.newlines++;
+            const qint64 line = seg.startLine + seg.newlines;
+            if (!(line % INDEX_STRIDE)) {
+                seg.index.append({line, nl + 1 - base});
+            }
+            ptr = nl + 1;
+        }
+
+        seg.used += len;
+        d->endsWithNewline = end[-1] == '\n';
+        data += len;
+        size -= len;
+    }
+    return true;
+}
+
+qint64 KPtyHistory::startOffset() const
+{
+    Q_D(const KPtyHistory);
+
+    return d->segments.isEmpty() ? 0 : d->segments.first().startOffset;
+}
+
+qint64 KPtyHistory::endOffset() const
+{
+    Q_D(const KPtyHistory);
+
+    if (d->segments.isEmpty()) {
+        return 0;
+    }
+    const KPtyHistorySegment &last = d->segments.last();
+    return last.startOffset + last.used;
+}
+
+qint64 KPtyHistory::startLine() const
+{
+    Q_D(const KPtyHistory);
+
+    if (d->segments.isEmpty()) {
+        return 0;
+    }
+    // the line the first segment starts in is only partially retained,
+    // unless the segment starts right at its beginning
+    const KPtyHistorySegment &first = d->segments.first();
+    return first.startsLine ? first.startLine : first.startLine + 1;
+}
+
+qint64 KPtyHistory::lineCount() const
+{
+    Q_D(const KPtyHistory);
+
+    if (d->segments.isEmpty()) {
+        return 0;
+    }
+    const KPtyHistorySegment &last = d->segments.last();
+    return last.startLine + last.newlines + 1;
+}
+
+qint64 KPtyHistory::lineOffset(qint64 line) const
+{
+    Q_D(const KPtyHistory);
+
+    if (line < startLine() || line >= lineCount()) {
+        return -1;
+    }
+    if (!line) {
+        return 0;
+    }
+
+    // find the segment holding the newline which terminates the preceding line
+    auto it = std::lower_bound(d->segments.cbegin(), d->segments.cend(), line, [](const KPtyHistorySegment &seg, qint64 l) {
+        return seg.startLine + seg.newlines < l;
+    });
+    Q_ASSERT(it != d->segments.cend());
+    const int idx = it - d->segments.cbegin();
+    const KPtyHistorySegment &seg = *it;
+
+    qint64 current = seg.startLine;
+    qint64 pos = 0;
+    auto entry = std::upper_bound(seg.index.cbegin(), seg.index.cend(), line, [](qint64 l, const KPtyHistorySegment::IndexEntry &e) {
+        return l < e.line;
+    });
+    if (entry != seg.index.cbegin()) {
+        --entry;
+        current = entry->line;
+        pos = entry->pos;
+    }
+    if (current == line) {
+        return seg.startOffset + pos;
+    }
+
+    const char *base = d->mapSegment(idx);
+    if (!base) {
+        return -1;
+    }
+    const char *ptr = base + pos;
+    const char *end = base + seg.used;
+    while (const char *nl = static_cast<const char *>(memchr(ptr, '\n', end - ptr))) {
+        ptr = nl + 1;
+        if (++current == line) {
+            return seg.startOffset + (ptr - base);
+        }
+    }
+    Q_UNREACHABLE_RETURN(-1);
+}
+
+qint64 KPtyHistory::read(qint64 offset, char *data, qint64 maxSize) const
+{
+    Q_D(const KPtyHistory);
+
+    int idx = d->segmentForOffset(offset);
+    if (idx < 0) {
+        return offset == endOffset() && offset >= startOffset() ? 0 : -1;
+    }
+
+    qint64 readSoFar = 0;
+    while (readSoFar < maxSize && idx < d->segments.size()) {
+        const char *base = d->mapSegment(idx);
+        if (!base) {
+            break;
+        }
+        const KPtyHistorySegment &seg = d->segments.at(idx);
+        const qint64 pos = offset + readSoFar - seg.startOffset;
+        const qint64 len = qMin(maxSize - readSoFar, seg.used - pos);
+        memcpy(data + readSoFar, base + pos, len);
+        readSoFar += len;
+        idx++;
+    }
+    return readSoFar;
+}
+
+QByteArray KPtyHistory::read(qint64 offset, qint64 maxSize) const
+{
+    QByteArray ret;
+    const qint64 size = qMin(maxSize, endOffset() - offset);
+    if (size <= 0) {
+        return ret;
+    }
+    ret.resize(size);
+    const qint64 got = read(offset, ret.data(), size);
+    ret.resize(qMax<qint64>(got, 0));
+    return ret;
+}
+
+QByteArray KPtyHistory::readLines(qint64 line, qint64 count) const
+{
+    const qint64 start = lineOffset(line);
+    if (start < 0 || count <= 0) {
+        return QByteArray();
+    }
+    const qint64 end = line + count < lineCount() ? lineOffset(line + count) : endOffset();
+    return read(start, end - start);
+}
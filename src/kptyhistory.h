@@ -0,0 +1,190 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef kptyhistory_h
+#define kptyhistory_h
+
+#include "kpty_export.h"
+
+#include <QByteArray>
+#include <QString>
+
+#include <memory>
+
+class KPtyHistoryPrivate;
+
+/*!
+ * \class KPtyHistory
+ * \inmodule KPty
+ *
+ * \brief File-backed store for the complete output history of a pty.
+ *
+ * The output is appended to a log made of fixed-size segments. Each
+ * segment lives in an unlinked temporary file and is accessed through
+ * mmap(2); only a fixed number of segments is kept mapped at any time,
+ * so the resident memory does not grow with the length of the history.
+ *
+ * Every byte of the history is addressed by its offset in the output
+ * stream. Lines are located through a sparse index, which records the
+ * position of every few hundredth line start; the rest is found by
+ * scanning from the nearest index entry.
+ *
+ * Attach the store to a KPtyDevice with KPtyDevice::setHistory() to have
+ * everything read from the pty appended automatically.
+ *
+ * \since 6.28
+ */
+class KPTY_EXPORT KPtyHistory
+{
+    Q_DECLARE_PRIVATE(KPtyHistory)
+
+public:
+    /*!
+     * \value KeepAll Never discard any output
+     * \value DropOldest Discard the oldest segments once the retained
+     *        output exceeds the maximum size
+     */
+    enum RetentionPolicy {
+        KeepAll,
+        DropOldest,
+    };
+
+    /*!
+     * Constructor
+     *
+     * \a segmentSize the size of each backing segment in bytes. It is
+     *  rounded up to a multiple of the page size.
+     *
+     * \a residentSegments the maximal number of segments which are
+     *  mapped into memory at the same time. At least one segment (the
+     *  one being written to) is always mapped.
+     */
+    explicit KPtyHistory(qint64 segmentSize = 1024 * 1024, int residentSegments = 4);
+
+    /*!
+     * Destructor:
+     *
+     * Unmaps and closes all segments. As the backing files are unlinked
+     * right after their creation, no files are left behind.
+     */
+    ~KPtyHistory();
+
+    KPtyHistory(const KPtyHistory &) = delete;
+    KPtyHistory &operator=(const KPtyHistory &) = delete;
+
+    /*!
+     * Prepare the store for writing.
+     *
+     * \a directory the directory to create the backing files in. If
+     *  empty, the application's cache directory is used, see
+     *  QStandardPaths::CacheLocation. The directory should be on a disk;
+     *  on a tmpfs, as which the temporary directory is often mounted, the
+     *  segments occupy memory or swap even while they are not mapped.
+     *
+     * Returns true if the first segment could be created
+     */
+    bool open(const QString &directory = QString());
+
+    /*!
+     * Discard all output and release all segments.
+     */
+    void close();
+
+    /*!
+     * Returns true if the store is open
+     */
+    bool isOpen() const;
+
+    /*!
+     * Set the policy for discarding old output.
+     *
+     * Output is always dropped by whole segments, so up to one segment
+     * more than \a maximumSize may be retained.
+     *
+     * \a policy the retention policy
+     *
+     * \a maximumSize the amount of output to retain with
+     *  KPtyHistory::DropOldest, in bytes
+     */
+    void setRetentionPolicy(RetentionPolicy policy, qint64 maximumSize = 0);
+
+    /*!
+     * Returns the retention policy
+     */
+    RetentionPolicy retentionPolicy() const;
+
+    /*!
+     * Append output to the store.
+     *
+     * Returns true on success, false if a new segment could not be created
+     */
+    bool append(const char *data, qint64 size);
+
+    /*!
+     * Returns the stream offset of the oldest retained byte
+     */
+    qint64 startOffset() const;
+
+    /*!
+     * Returns the stream offset following the last byte, i.e., the
+     * total number of bytes appended so far
+     */
+    qint64 endOffset() const;
+
+    /*!
+     * Returns the number of the oldest line whose start is retained
+     */
+    qint64 startLine() const;
+
+    /*!
+     * Returns the number of lines, counting the unterminated last one
+     */
+    qint64 lineCount() const;
+
+    /*!
+     * Find the start of a line.
+     *
+     * Lines are numbered from zero, the first line starting at stream
+     * offset zero.
+     *
+     * Returns the stream offset of the start of \a line, or -1 if the
+     * line does not exist or was already dropped
+     */
+    qint64 lineOffset(qint64 line) const;
+
+    /*!
+     * Copy retained output to a buffer.
+     *
+     * \a offset the stream offset to start reading at
+     *
+     * \a data the buffer to copy to
+     *
+     * \a maxSize the size of the buffer
+     *
+     * Returns the number of bytes copied, or -1 if \a offset is not
+     *  retained
+     */
+    qint64 read(qint64 offset, char *data, qint64 maxSize) const;
+
+    /*!
+     * \overload
+     * Returns up to \a maxSize bytes of retained output starting at
+     * \a offset
+     */
+    QByteArray read(qint64 offset, qint64 maxSize) const;
+
+    /*!
+     * Returns up to \a count lines starting with \a line, including
+     * their terminating newlines
+     */
+    QByteArray readLines(qint64 line, qint64 count) const;
+
+private:
+    std::unique_ptr<KPtyHistoryPrivate> const d_ptr;
+};
+
+#endif
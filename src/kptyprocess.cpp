@@ -6,12 +6,25 @@
 */
 
 #include "kptyprocess.h"
+#include "kptydevice_p.h"
 
+#include <kpty_debug.h>
 #include <kptydevice.h>
 #include <kuser.h>
 
+#include <QDeadlineTimer>
+
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <poll.h>
 #include <stdlib.h>
+#include <sys/wait.h>
 #include <unistd.h>
+#ifdef Q_OS_LINUX
+#include <sys/syscall.h>
+#endif
 
 //////////////////
 // private data //
@@ -24,11 +37,198 @@ public:
     {
     }
 
+    bool waitForExit(pid_t pid, const QDeadlineTimer &deadline);
+    void drainPty();
+    KPtyProcess::CaptureResult capture(KPtyProcess *q,
+                                       const std::function<QSpan<char>(qsizetype)> &acquire,
+                                       const std::function<void(QSpan<char>)> &commit,
+                                       const QDeadlineTimer &deadline);
+
     std::unique_ptr<KPtyDevice> pty;
     KPtyProcess::PtyChannels ptyChannels = KPtyProcess::NoChannels;
     bool addUtmp = false;
 };
 
+// how often the process is checked for when there is no pidfd
+static const int s_exitPollInterval = 10;
+
+// for autotests, to take the path of platforms without pidfd
+KPTY_EXPORT bool kpty_use_pidfd = true;
+
+static int openPidFd(pid_t pid)
+{
+#if defined(Q_OS_LINUX) && defined(SYS_pidfd_open)
+    if (kpty_use_pidfd) {
+        return int(syscall(SYS_pidfd_open, pid, 0));
+    }
+#else
+    Q_UNUSED(pid);
+#endif
+    return -1;
+}
+
+// Check whether the process exited, without reaping it, which is up to QProcess.
+// Where QProcess reaps its children from a SIGCHLD handler, it may be gone already.
+static bool hasExited(pid_t pid)
+{
+    siginfo_t info;
+    info.si_pid = 0;
+    if (waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT)) {
+        return errno == ECHILD;
+    }
+    return info.si_pid == pid;
+}
+
+bool KPtyProcessPrivate::waitForExit(pid_t pid, const QDeadlineTimer &deadline)
+{
+    KPtyDevicePrivate *dd = pty->d_func();
+    const int pidfd = openPidFd(pid);
+
+    bool exited = false;
+    while (!exited) {
+        short events = 0;
+        if (!dd->suspended && !dd->eof && !dd->throttled && !dd->readersLagging()) {
+            events |= POLLIN;
+        }
+        if (dd->hasPendingWrites()) {
+            events |= POLLOUT;
+        }
+        struct pollfd fds[2] = {{events ? pty->masterFd() : -1, events, 0}, {pidfd, POLLIN, 0}};
+
+        QDeadlineTimer wakeup = deadline;
+        if (dd->throttled && dd->throttleDeadline < wakeup) {
+            wakeup = dd->throttleDeadline;
+        }
+        if (pidfd < 0) {
+            const QDeadlineTimer interval(s_exitPollInterval, Qt::PreciseTimer);
+            if (interval < wakeup) {
+                wakeup = interval;
+            }
+        }
+        const int timeout = wakeup.isForever() ? -1 : int(qMin<qint64>(wakeup.remainingTime(), KMAXINT));
+
+        const int ret = poll(fds, pidfd >= 0 ? 2 : 1, timeout);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[0].revents & (POLLIN | POLLHUP)) {
+            dd->_k_canRead();
+        }
+        if (fds[0].revents & POLLOUT) {
+            dd->_k_canWrite();
+        }
+        if (dd->throttled && dd->throttleDeadline.hasExpired()) {
+            dd->unthrottle();
+        }
+        if (pidfd >= 0 ? bool(fds[1].revents & POLLIN) : hasExited(pid)) {
+            exited = true;
+        } else if (deadline.hasExpired()) {
+            break;
+        }
+    }
+
+    if (pidfd >= 0) {
+        ::close(pidfd);
+    }
+    return exited;
+}
+
+void KPtyProcessPrivate::drainPty()
+{
+    KPtyDevicePrivate *dd = pty->d_func();
+
+    // poll() pushes data still in transit through the driver, so everything
+    // the process wrote before exiting is seen
+    while (!dd->suspended && !dd->eof && !dd->readersLagging()) {
+        if (dd->throttled) {
+            const qint64 remaining = dd->throttleDeadline.remainingTime();
+            if (remaining > 0) {
+                poll(nullptr, 0, int(qMin<qint64>(remaining, KMAXINT)));
+            }
+            dd->unthrottle();
+        }
+        struct pollfd pfd = {pty->masterFd(), POLLIN, 0};
+        if (poll(&pfd, 1, 0) <= 0 || !(pfd.revents & (POLLIN | POLLHUP))) {
+            break;
+        }
+        // control packets are no progress, but no reason to stop either
+        if (!dd->_k_canRead() && !dd->packetMode && !dd->throttled) {
+            break;
+        }
+    }
+}
+
+KPtyProcess::CaptureResult KPtyProcessPrivate::capture(KPtyProcess *q,
+                                                       const std::function<QSpan<char>(qsizetype)> &acquire,
+                                                       const std::function<void(QSpan<char>)> &commit,
+                                                       const QDeadlineTimer &deadline)
+{
+    KPtyProcess::CaptureResult result;
+
+    if (q->state() == QProcess::Starting && !q->waitForStarted(int(qMin<qint64>(deadline.remainingTime(), KMAXINT)))) {
+        return result;
+    }
+    if (q->state() != QProcess::Running || pty->masterFd() < 0) {
+        return result;
+    }
+
+    // a sink the application set is put back afterwards
+    KPtyDevicePrivate *dd = pty->d_func();
+    const auto previousAcquire = std::exchange(dd->readSinkAcquire, acquire);
+    const auto previousCommit = std::exchange(dd->readSinkCommit, commit);
+
+    const bool exited = waitForExit(pid_t(q->processId()), deadline);
+    if (exited) {
+        drainPty();
+    }
+
+    dd->readSinkAcquire = previousAcquire;
+    dd->readSinkCommit = previousCommit;
+
+    // the process is gone already, so this merely reaps it
+    if (exited && q->waitForFinished(-1)) {
+        result.finished = true;
+        result.exitCode = q->exitCode();
+        result.exitStatus = q->exitStatus();
+    }
+    return result;
+}
+
+static QDeadlineTimer captureDeadline(int msecs)
+{
+    return msecs < 0 ? QDeadlineTimer(QDeadlineTimer::Forever) : QDeadlineTimer(msecs, Qt::PreciseTimer);
+}
+
+// Write all of data, waiting for a non-blocking descriptor to take it.
+static bool writeFully(int fd, const char *data, qint64 size, const QDeadlineTimer &deadline)
+{
+    while (size > 0) {
+        const ssize_t written = ::write(fd, data, size_t(size));
+        if (written >= 0) {
+            data += written;
+            size -= written;
+            continue;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            return false;
+        }
+        struct pollfd pfd = {fd, POLLOUT, 0};
+        const int timeout = deadline.isForever() ? -1 : int(qMin<qint64>(deadline.remainingTime(), KMAXINT));
+        const int ret = poll(&pfd, 1, timeout);
+        if (ret == 0 || (ret < 0 && errno != EINTR)) {
+            errno = ret ? errno : ETIMEDOUT;
+            return false;
+        }
+    }
+    return true;
+}
+
 KPtyProcess::KPtyProcess(QObject *parent)
     : KPtyProcess(-1, parent)
 {
@@ -121,4 +321,89 @@ KPtyDevice *KPtyProcess::pty() const
     return d->pty.get();
 }
 
+bool KPtyProcess::waitForPtyFinished(int msecs)
+{
+    Q_D(KPtyProcess);
+
+    const QDeadlineTimer deadline(msecs < 0 ? QDeadlineTimer(QDeadlineTimer::Forever) : QDeadlineTimer(msecs, Qt::PreciseTimer));
+
+    if (state() == QProcess::Starting && !waitForStarted(int(qMin<qint64>(deadline.remainingTime(), KMAXINT)))) {
+        return false;
+    }
+    if (state() != QProcess::Running || d->pty->masterFd() < 0) {
+        return false;
+    }
+
+    if (!d->waitForExit(pid_t(processId()), deadline)) {
+        return false;
+    }
+    d->drainPty();
+
+    // the process is gone already, so this merely reaps it
+    return waitForFinished(-1);
+}
+
+KPtyProcess::CaptureResult KPtyProcess::captureOutput(int fd, int msecs)
+{
+    Q_D(KPtyProcess);
+
+    const QDeadlineTimer deadline = captureDeadline(msecs);
+    qint64 captured = 0;
+    bool failed = false;
+    auto store = [fd, &deadline, &captured, &failed](const char *data, qint64 size) {
+        if (failed || !size) {
+            return;
+        }
+        if (!writeFully(fd, data, size, deadline)) {
+            qCWarning(KPTY_LOG) << "Failed to write captured output:" << strerror(errno);
+            failed = true;
+            return;
+        }
+        captured += size;
+    };
+
+    const QByteArray buffered = d->pty->readAll();
+    store(buffered.constData(), buffered.size());
+
+    QByteArray chunk;
+    CaptureResult result = d->capture(
+        this,
+        [&chunk](qsizetype hint) {
+            if (chunk.size() < hint) {
+                chunk.resize(hint);
+            }
+            return QSpan<char>(chunk.data(), chunk.size());
+        },
+        [&store](QSpan<char> data) {
+            store(data.data(), data.size());
+        },
+        deadline);
+    result.capturedSize = captured;
+    return result;
+}
+
+KPtyProcess::CaptureResult KPtyProcess::captureOutput(QByteArray *buffer, int msecs)
+{
+    Q_D(KPtyProcess);
+
+    const qsizetype start = buffer->size();
+    buffer->append(d->pty->readAll());
+
+    // read into the spare room at the end, which grows geometrically
+    qsizetype used = buffer->size();
+    CaptureResult result = d->capture(
+        this,
+        [buffer, &used](qsizetype hint) {
+            buffer->resize(used + hint);
+            return QSpan<char>(buffer->data() + used, hint);
+        },
+        [buffer, &used](QSpan<char> data) {
+            used += data.size();
+            buffer->resize(used);
+        },
+        captureDeadline(msecs));
+    result.capturedSize = buffer->size() - start;
+    return result;
+}
+
 #include "moc_kptyprocess.cpp"
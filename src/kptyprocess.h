@@ -32,7 +32,8 @@ class KPtyProcessPrivate;
  *
  * No attempt to integrate with QProcess' waitFor*() functions was made,
  * for it is impossible. Note that execute() does not work with the PTY, too.
- * Use the PTY device's waitFor*() functions or use it asynchronously.
+ * Use the PTY device's waitFor*() functions, waitForPtyFinished(), or use
+ * it asynchronously.
  *
  * \note If you inherit from this class and use setChildProcessModifier() in
  * the derived class, you must call the childProcessModifier() of KPtyProcess
@@ -141,6 +142,103 @@ public:
      */
     KPtyDevice *pty() const;
 
+    /*!
+     * Block until the process has finished, reading its output meanwhile.
+     *
+     * Waits for the process and the PTY together, so the output is read as
+     * it arrives and the process is never blocked on a full PTY. Data
+     * written to the PTY is passed on as well. Once the process has exited,
+     * all the output it produced is read before finished() is emitted, so
+     * it is available from pty() afterwards. Output which is written by
+     * processes outliving the child is not waited for.
+     *
+     * On Linux, the process is watched through a pidfd, so a single poll()
+     * waits for both. Elsewhere, the process is checked for in short
+     * intervals.
+     *
+     * \a msecs the time to wait, or -1 to wait forever
+     *
+     * Returns true if the process has finished, false if it is not running
+     *  or the wait timed out
+     *
+     * \since 6.28
+     */
+    bool waitForPtyFinished(int msecs = 30000);
+
+    /*!
+     * \class KPtyProcess::CaptureResult
+     * \inmodule KPty
+     *
+     * \brief The outcome of captureOutput().
+     *
+     * \since 6.28
+     */
+    struct CaptureResult {
+        /*!
+         * \variable KPtyProcess::CaptureResult::finished
+         * Whether the process finished; false if it was not running or the
+         * wait timed out
+         */
+        bool finished = false;
+        /*!
+         * \variable KPtyProcess::CaptureResult::exitCode
+         * The exit code of the process, if it finished
+         */
+        int exitCode = -1;
+        /*!
+         * \variable KPtyProcess::CaptureResult::exitStatus
+         * The exit status of the process, if it finished
+         */
+        QProcess::ExitStatus exitStatus = QProcess::NormalExit;
+        /*!
+         * \variable KPtyProcess::CaptureResult::capturedSize
+         * The number of bytes which were captured
+         */
+        qint64 capturedSize = 0;
+    };
+
+    /*!
+     * Block until the process has finished, writing its output to a file
+     * descriptor.
+     *
+     * This is meant for batch jobs which run under a PTY only so the
+     * programs behave as they would in a terminal, and which merely need
+     * the output stored. No event loop is needed: the process and the PTY
+     * are waited for like with waitForPtyFinished(), and the output is read
+     * into a sink (see KPtyDevice::setReadSink()) which writes it out right
+     * away. Output which was already buffered in pty() is written first.
+     *
+     * Output on channels which are not assigned to the PTY is not read
+     * meanwhile, so it should not exceed what its pipe holds.
+     *
+     * If writing fails, the rest of the output is discarded, so the process
+     * is not blocked; capturedSize then tells how much was written.
+     *
+     * \a fd the descriptor to write to; it is not closed
+     *
+     * \a msecs the time to wait, or -1 to wait forever
+     *
+     * Returns the exit status and the size of the captured output
+     *
+     * \since 6.28
+     */
+    CaptureResult captureOutput(int fd, int msecs = -1);
+
+    /*!
+     * Block until the process has finished, appending its output to
+     * \a buffer.
+     *
+     * The output is read straight into the buffer, which grows as needed.
+     * Otherwise, this works like captureOutput(int, int).
+     *
+     * \a msecs the time to wait, or -1 to wait forever
+     *
+     * Returns the exit status and the size of the captured output
+     *
+     * \since 6.28
+     */
+    CaptureResult captureOutput(QByteArray *buffer, int msecs = -1);
+
 private:
     std::unique_ptr<KPtyProcessPrivate> const d_ptr;
 };
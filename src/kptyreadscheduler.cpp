@@ -0,0 +1,182 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kptyreadscheduler.h"
+#include "kptydevice_p.h"
+#include "kptyreadscheduler_p.h"
+
+#include <QPointer>
+
+#include <poll.h>
+
+//////////////////
+// private data //
+//////////////////
+
+void KPtyReadSchedulerPrivate::schedule(KPtyDevicePrivate *device)
+{
+    // the device's notifier stays disabled until its backlog is drained
+    device->scheduled = true;
+    device->updateReadNotifier();
+    active.append(device);
+    postRound();
+}
+
+void KPtyReadSchedulerPrivate::unschedule(KPtyDevicePrivate *device)
+{
+    if (!device->scheduled) {
+        return;
+    }
+    active.removeOne(device);
+    device->scheduled = false;
+    device->deficit = 0;
+    device->updateReadNotifier();
+}
+
+void KPtyReadSchedulerPrivate::postRound()
+{
+    Q_Q(KPtyReadScheduler);
+
+    if (roundPending) {
+        return;
+    }
+    roundPending = true;
+    QMetaObject::invokeMethod(
+        q,
+        [this]() {
+            runRound();
+        },
+        Qt::QueuedConnection);
+}
+
+static bool hasPendingData(const KPtyDevicePrivate *device)
+{
+    struct pollfd pfd = {device->masterFd, POLLIN, 0};
+    return poll(&pfd, 1, 0) > 0;
+}
+
+void KPtyReadSchedulerPrivate::runRound()
+{
+    roundPending = false;
+
+    // readyRead handlers may add, remove or even delete devices
+    const QList<KPtyDevicePrivate *> round = active;
+    for (KPtyDevicePrivate *device : round) {
+        if (!active.contains(device)) {
+            continue;
+        }
+
+        // the backlog may have been consumed by waitForReadyRead() meanwhile,
+        // in which case reading now would be mistaken for EOF
+        if (!hasPendingData(device)) {
+            unschedule(device);
+            continue;
+        }
+
+        // a single read is capped well below large quanta, so keep reading
+        // until the allowance is used up or the kernel buffer is drained
+        device->deficit += quantum;
+        QPointer<KPtyDevice> guard(static_cast<KPtyDevice *>(device->q_ptr));
+        while (device->deficit > 0) {
+            const qint64 before = device->stats.bytesRead;
+            device->_k_canRead(int(qMin<qint64>(device->deficit, KMAXINT)));
+            if (!guard || !active.contains(device)) {
+                break;
+            }
+            const qint64 got = device->stats.bytesRead - before;
+            device->deficit -= got;
+            if (!got || device->suspended || device->eof || device->throttled || device->readersLagging() || !hasPendingData(device)) {
+                break;
+            }
+        }
+        if (!guard || !active.contains(device)) {
+            continue;
+        }
+
+        // the rest of the allowance carries over to the next round only
+        // while there is data left which may be read
+        if (device->suspended || device->eof || device->throttled || device->readersLagging() || !hasPendingData(device)) {
+            unschedule(device);
+        }
+    }
+
+    if (!active.isEmpty()) {
+        postRound();
+    }
+}
+
+/////////////////////////////
+// public member functions //
+/////////////////////////////
+
+KPtyReadScheduler::KPtyReadScheduler(QObject *parent)
+    : QObject(parent)
+    , d_ptr(new KPtyReadSchedulerPrivate(this))
+{
+}
+
+KPtyReadScheduler::~KPtyReadScheduler()
+{
+    Q_D(KPtyReadScheduler);
+
+    while (!d->devices.isEmpty()) {
+        removeDevice(d->devices.first());
+    }
+}
+
+void KPtyReadScheduler::addDevice(KPtyDevice *device)
+{
+    Q_D(KPtyReadScheduler);
+
+    Q_ASSERT_X(device->thread() == thread(), "KPtyReadScheduler::addDevice", "device lives in a different thread");
+
+    auto dd = static_cast<KPtyDevicePrivate *>(device->d_ptr.get());
+    if (dd->scheduler == d) {
+        return;
+    }
+    if (dd->scheduler) {
+        dd->scheduler->q_func()->removeDevice(device);
+    }
+    dd->scheduler = d;
+    d->devices.append(device);
+}
+
+void KPtyReadScheduler::removeDevice(KPtyDevice *device)
+{
+    Q_D(KPtyReadScheduler);
+
+    auto dd = static_cast<KPtyDevicePrivate *>(device->d_ptr.get());
+    if (dd->scheduler != d) {
+        return;
+    }
+    d->unschedule(dd);
+    dd->scheduler = nullptr;
+    d->devices.removeOne(device);
+}
+
+QList<KPtyDevice *> KPtyReadScheduler::devices() const
+{
+    Q_D(const KPtyReadScheduler);
+
+    return d->devices;
+}
+
+void KPtyReadScheduler::setQuantum(qint64 bytes)
+{
+    Q_D(KPtyReadScheduler);
+
+    d->quantum = qMax<qint64>(1, bytes);
+}
+
+qint64 KPtyReadScheduler::quantum() const
+{
+    Q_D(const KPtyReadScheduler);
+
+    return d->quantum;
+}
+
+#include "moc_kptyreadscheduler.cpp"
@@ -0,0 +1,99 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef kptyreadscheduler_h
+#define kptyreadscheduler_h
+
+#include "kpty_export.h"
+
+#include <QList>
+#include <QObject>
+
+#include <memory>
+
+class KPtyDevice;
+class KPtyReadSchedulerPrivate;
+
+/*!
+ * \class KPtyReadScheduler
+ * \inmodule KPty
+ *
+ * \brief Shares the reading throughput fairly among a group of KPtyDevices.
+ *
+ * On its own, a KPtyDevice drains everything the kernel has buffered
+ * whenever the pty becomes readable, so a device flooded with output
+ * takes as much CPU time as its kernel buffer permits.
+ *
+ * Devices added to a scheduler are instead served in rounds, each of
+ * which runs as a separate event loop turn. In every round, each ready
+ * device may read up to quantum() bytes plus whatever it did not use
+ * of its share in the previous round (deficit round-robin). Devices with
+ * little output, like interactive sessions, are thus served in the next
+ * round regardless of how much the other devices have pending, while the
+ * remaining throughput is split evenly among the busy ones.
+ *
+ * A device can belong to only one scheduler, and must live in the same
+ * thread as it.
+ *
+ * \since 6.28
+ */
+class KPTY_EXPORT KPtyReadScheduler : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(KPtyReadScheduler)
+
+public:
+    /*!
+     * Constructor
+     */
+    explicit KPtyReadScheduler(QObject *parent = nullptr);
+
+    /*!
+     * Destructor:
+     *
+     * All devices are removed from the scheduler.
+     */
+    ~KPtyReadScheduler() override;
+
+    /*!
+     * Add a device to the scheduler.
+     *
+     * The device is removed from its previous scheduler, if any. It is
+     * removed automatically when it is destroyed.
+     */
+    void addDevice(KPtyDevice *device);
+
+    /*!
+     * Remove a device from the scheduler.
+     *
+     * The device goes back to reading whenever the pty becomes readable.
+     */
+    void removeDevice(KPtyDevice *device);
+
+    /*!
+     * Returns the devices in the scheduler
+     */
+    QList<KPtyDevice *> devices() const;
+
+    /*!
+     * Set the amount of data each device may read per round, in bytes.
+     *
+     * The default is 16384 bytes. Smaller values improve the latency of
+     * lightly loaded devices at the cost of more event loop turns.
+     */
+    void setQuantum(qint64 bytes);
+
+    /*!
+     * Returns the amount of data each device may read per round
+     */
+    qint64 quantum() const;
+
+private:
+    std::unique_ptr<KPtyReadSchedulerPrivate> const d_ptr;
+};
+
+#endif
@@ -0,0 +1,39 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef kptyreadscheduler_p_h
+#define kptyreadscheduler_p_h
+
+#include "kptyreadscheduler.h"
+
+class KPtyDevicePrivate;
+
+class KPtyReadSchedulerPrivate
+{
+public:
+    Q_DECLARE_PUBLIC(KPtyReadScheduler)
+
+    KPtyReadSchedulerPrivate(KPtyReadScheduler *parent)
+        : q_ptr(parent)
+    {
+    }
+
+    void schedule(KPtyDevicePrivate *device);
+    void unschedule(KPtyDevicePrivate *device);
+    void postRound();
+    void runRound();
+
+    QList<KPtyDevice *> devices;
+    // devices with pending data, in service order
+    QList<KPtyDevicePrivate *> active;
+    qint64 quantum = 16384;
+    bool roundPending = false;
+
+    KPtyReadScheduler *q_ptr;
+};
+
+#endif
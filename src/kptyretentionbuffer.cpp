@@ -0,0 +1,314 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kptyretentionbuffer.h"
+
+#include <config-pty.h>
+#include <kpty_debug.h>
+
+#include <QList>
+#include <QMutex>
+#include <QThreadPool>
+
+#include <atomic>
+#include <time.h>
+
+#if HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+//////////////////
+// private data //
+//////////////////
+
+struct KPtyRetentionBlock {
+    QMutex mutex;
+    QByteArray data; // guarded by mutex, as it is replaced once compressed
+    KPtyRetentionBuffer::Compression compression = KPtyRetentionBuffer::NoCompression;
+    qint64 rawSize = 0;
+};
+
+// Shared with the compression jobs, which may outlive the buffer.
+struct KPtyRetentionCounters {
+    std::atomic<qint64> compressionTime{0};
+    std::atomic<qint64> decompressionTime{0};
+};
+
+static qint64 threadCpuTime()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static QByteArray compressBlock(const QByteArray &raw, KPtyRetentionBuffer::Compression compression)
+{
+    switch (compression) {
+#if HAVE_ZSTD
+    case KPtyRetentionBuffer::Zstd: {
+        QByteArray packed;
+        packed.resize(ZSTD_compressBound(raw.size()));
+        size_t size = ZSTD_compress(packed.data(), packed.size(), raw.constData(), raw.size(), 3);
+        if (ZSTD_isError(size)) {
+            qCWarning(KPTY_LOG) << "Can't compress retained output:" << ZSTD_getErrorName(size);
+            return QByteArray();
+        }
+        packed.resize(size);
+        packed.squeeze();
+        return packed;
+    }
+#endif
+#ifndef QT_NO_COMPRESS
+    case KPtyRetentionBuffer::Zlib:
+        return qCompress(raw);
+#endif
+    default:
+        return QByteArray();
+    }
+}
+
+static QByteArray decompressBlock(const QByteArray &packed, KPtyRetentionBuffer::Compression compression, qint64 rawSize)
+{
+    switch (compression) {
+#if HAVE_ZSTD
+    case KPtyRetentionBuffer::Zstd: {
+        QByteArray raw;
+        raw.resize(rawSize);
+        size_t size = ZSTD_decompress(raw.data(), raw.size(), packed.constData(), packed.size());
+        if (ZSTD_isError(size)) {
+            qCWarning(KPTY_LOG) << "Can't decompress retained output:" << ZSTD_getErrorName(size);
+            return QByteArray();
+        }
+        return raw;
+    }
+#endif
+#ifndef QT_NO_COMPRESS
+    case KPtyRetentionBuffer::Zlib:
+        return qUncompress(packed);
+#endif
+    default:
+        Q_UNUSED(rawSize);
+        return packed;
+    }
+}
+
+class KPtyRetentionBufferPrivate
+{
+public:
+    KPtyRetentionBufferPrivate(qint64 cap, qint64 bs)
+        : capacity(cap)
+        , blockSize(qMax<qint64>(bs, 1024))
+        , counters(std::make_shared<KPtyRetentionCounters>())
+    {
+    }
+
+    void closeBlock();
+    void evict();
+
+    qint64 capacity;
+    qint64 blockSize;
+    KPtyRetentionBuffer::Compression compression = KPtyRetentionBuffer::defaultCompression();
+    QList<std::shared_ptr<KPtyRetentionBlock>> closed;
+    qint64 closedSize = 0; // uncompressed
+    QByteArray open;
+    std::shared_ptr<KPtyRetentionCounters> counters;
+};
+
+void KPtyRetentionBufferPrivate::closeBlock()
+{
+    auto block = std::make_shared<KPtyRetentionBlock>();
+    block->data = open;
+    block->rawSize = open.size();
+    closed.append(block);
+    closedSize += block->rawSize;
+    open = QByteArray();
+
+    evict();
+
+    if (compression == KPtyRetentionBuffer::NoCompression) {
+        return;
+    }
+    QThreadPool::globalInstance()->start([block, counters = counters, method = compression]() {
+        const qint64 start = threadCpuTime();
+
+        QByteArray raw;
+        {
+            QMutexLocker locker(&block->mutex);
+            raw = block->data;
+        }
+        QByteArray packed = compressBlock(raw, method);
+        counters->compressionTime += threadCpuTime() - start;
+
+        // keep incompressible blocks as they are
+        if (packed.isEmpty() || packed.size() >= raw.size()) {
+            return;
+        }
+        QMutexLocker locker(&block->mutex);
+        block->data = packed;
+        block->compression = method;
+    });
+}
+
+void KPtyRetentionBufferPrivate::evict()
+{
+    while (!closed.isEmpty() && closedSize + open.size() - closed.first()->rawSize >= capacity) {
+        closedSize -= closed.first()->rawSize;
+        closed.removeFirst();
+    }
+}
+
+/////////////////////////////
+// public member functions //
+/////////////////////////////
+
+KPtyRetentionBuffer::KPtyRetentionBuffer(qint64 capacity, qint64 blockSize)
+    : d_ptr(new KPtyRetentionBufferPrivate(capacity, blockSize))
+{
+}
+
+KPtyRetentionBuffer::~KPtyRetentionBuffer()
+{
+}
+
+KPtyRetentionBuffer::Compression KPtyRetentionBuffer::defaultCompression()
+{
+#if HAVE_ZSTD
+    return Zstd;
+#elif !defined(QT_NO_COMPRESS)
+    return Zlib;
+#else
+    return NoCompression;
+#endif
+}
+
+void KPtyRetentionBuffer::setCompression(Compression compression)
+{
+    Q_D(KPtyRetentionBuffer);
+
+#if !HAVE_ZSTD
+    if (compression == Zstd) {
+        compression = defaultCompression();
+    }
+#endif
+#ifdef QT_NO_COMPRESS
+    if (compression == Zlib) {
+        compression = defaultCompression();
+    }
+#endif
+    d->compression = compression;
+}
+
+KPtyRetentionBuffer::Compression KPtyRetentionBuffer::compression() const
+{
+    Q_D(const KPtyRetentionBuffer);
+
+    return d->compression;
+}
+
+void KPtyRetentionBuffer::setCapacity(qint64 capacity)
+{
+    Q_D(KPtyRetentionBuffer);
+
+    d->capacity = capacity;
+    d->evict();
+}
+
+qint64 KPtyRetentionBuffer::capacity() const
+{
+    Q_D(const KPtyRetentionBuffer);
+
+    return d->capacity;
+}
+
+void KPtyRetentionBuffer::append(const char *data, qint64 size)
+{
+    Q_D(KPtyRetentionBuffer);
+
+    while (size > 0) {
+        if (d->open.isEmpty()) {
+            d->open.reserve(d->blockSize);
+        }
+        const qint64 len = qMin(size, d->blockSize - d->open.size());
+        d->open.append(data, len);
+        data += len;
+        size -= len;
+        if (d->open.size() == d->blockSize) {
+            d->closeBlock();
+        }
+    }
+}
+
+void KPtyRetentionBuffer::clear()
+{
+    Q_D(KPtyRetentionBuffer);
+
+    d->closed.clear();
+    d->closedSize = 0;
+    d->open = QByteArray();
+}
+
+qint64 KPtyRetentionBuffer::size() const
+{
+    Q_D(const KPtyRetentionBuffer);
+
+    return qMin(d->closedSize + d->open.size(), d->capacity);
+}
+
+QByteArray KPtyRetentionBuffer::replay() const
+{
+    Q_D(const KPtyRetentionBuffer);
+
+    // skip the part of the oldest block which exceeds the capacity
+    qint64 skip = qMax<qint64>(0, d->closedSize + d->open.size() - d->capacity);
+
+    QByteArray ret;
+    ret.reserve(size());
+    for (const auto &block : d->closed) {
+        if (skip >= block->rawSize) {
+            skip -= block->rawSize;
+            continue;
+        }
+
+        QByteArray data;
+        Compression method;
+        {
+            QMutexLocker locker(&block->mutex);
+            data = block->data;
+            method = block->compression;
+        }
+        if (method != NoCompression) {
+            const qint64 start = threadCpuTime();
+            data = decompressBlock(data, method, block->rawSize);
+            d->counters->decompressionTime += threadCpuTime() - start;
+        }
+        if (data.size() > skip) {
+            ret.append(data.constData() + skip, data.size() - skip);
+        }
+        skip = 0;
+    }
+    ret.append(d->open.constData() + skip, d->open.size() - skip);
+    return ret;
+}
+
+KPtyRetentionBuffer::Statistics KPtyRetentionBuffer::statistics() const
+{
+    Q_D(const KPtyRetentionBuffer);
+
+    Statistics stats;
+    stats.retainedBytes = d->closedSize + d->open.size();
+    stats.storedBytes = d->open.size();
+    for (const auto &block : d->closed) {
+        QMutexLocker locker(&block->mutex);
+        stats.storedBytes += block->data.size();
+        if (block->compression != NoCompression) {
+            stats.compressedBlocks++;
+        }
+    }
+    stats.compressionTime = d->counters->compressionTime;
+    stats.decompressionTime = d->counters->decompressionTime;
+    return stats;
+}
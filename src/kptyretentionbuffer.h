@@ -0,0 +1,179 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef kptyretentionbuffer_h
+#define kptyretentionbuffer_h
+
+#include "kpty_export.h"
+
+#include <QByteArray>
+
+#include <memory>
+
+class KPtyRetentionBufferPrivate;
+
+/*!
+ * \class KPtyRetentionBuffer
+ * \inmodule KPty
+ *
+ * \brief Keeps the most recent output of a pty in compressed form.
+ *
+ * The output is collected in blocks. As soon as a block is full, it is
+ * closed and compressed on a thread of the global QThreadPool, while new
+ * output goes to the next block. Compressed blocks are only decompressed
+ * when the retained output is replayed.
+ *
+ * Zstandard is used when KPty was built with libzstd, zlib otherwise.
+ *
+ * Attach the buffer to a KPtyDevice with KPtyDevice::setRetentionBuffer()
+ * to have everything read from the pty retained automatically.
+ *
+ * All member functions must be called from the same thread.
+ *
+ * \since 6.28
+ */
+class KPTY_EXPORT KPtyRetentionBuffer
+{
+    Q_DECLARE_PRIVATE(KPtyRetentionBuffer)
+
+public:
+    /*!
+     * \value NoCompression Keep closed blocks as they are
+     * \value Zlib Compress closed blocks with zlib
+     * \value Zstd Compress closed blocks with Zstandard
+     */
+    enum Compression {
+        NoCompression,
+        Zlib,
+        Zstd,
+    };
+
+    /*!
+     * \class KPtyRetentionBuffer::Statistics
+     * \inmodule KPty
+     *
+     * \brief Memory and CPU usage of a retention buffer.
+     */
+    struct Statistics {
+        /*!
+         * \variable KPtyRetentionBuffer::Statistics::retainedBytes
+         * The amount of retained output
+         */
+        qint64 retainedBytes = 0;
+        /*!
+         * \variable KPtyRetentionBuffer::Statistics::storedBytes
+         * The amount of memory holding the retained output
+         */
+        qint64 storedBytes = 0;
+        /*!
+         * \variable KPtyRetentionBuffer::Statistics::compressedBlocks
+         * The number of retained blocks which are compressed
+         */
+        qint64 compressedBlocks = 0;
+        /*!
+         * \variable KPtyRetentionBuffer::Statistics::compressionTime
+         * The CPU time spent compressing, in nanoseconds
+         */
+        qint64 compressionTime = 0;
+        /*!
+         * \variable KPtyRetentionBuffer::Statistics::decompressionTime
+         * The CPU time spent decompressing, in nanoseconds
+         */
+        qint64 decompressionTime = 0;
+
+        /*!
+         * Returns the ratio of retained output to used memory
+         */
+        double compressionRatio() const
+        {
+            return storedBytes ? double(retainedBytes) / storedBytes : 1.0;
+        }
+    };
+
+    /*!
+     * Constructor
+     *
+     * \a capacity the amount of most recent output to retain, in bytes
+     *
+     * \a blockSize the amount of output compressed as one unit, in bytes.
+     *  Larger blocks compress better, but the open block is kept
+     *  uncompressed.
+     */
+    explicit KPtyRetentionBuffer(qint64 capacity = 4 * 1024 * 1024, qint64 blockSize = 64 * 1024);
+
+    /*!
+     * Destructor
+     *
+     * Compression jobs still in progress finish in the background.
+     */
+    ~KPtyRetentionBuffer();
+
+    KPtyRetentionBuffer(const KPtyRetentionBuffer &) = delete;
+    KPtyRetentionBuffer &operator=(const KPtyRetentionBuffer &) = delete;
+
+    /*!
+     * Returns the best compression method KPty was built with
+     */
+    static Compression defaultCompression();
+
+    /*!
+     * Set the compression method for blocks closed from now on.
+     *
+     * Methods KPty was not built with fall back to defaultCompression().
+     */
+    void setCompression(Compression compression);
+
+    /*!
+     * Returns the compression method
+     */
+    Compression compression() const;
+
+    /*!
+     * Set the amount of most recent output to retain, in bytes.
+     *
+     * Output is discarded by whole blocks, so up to one block more may be
+     * kept in memory.
+     */
+    void setCapacity(qint64 capacity);
+
+    /*!
+     * Returns the amount of most recent output to retain, in bytes
+     */
+    qint64 capacity() const;
+
+    /*!
+     * Append output to the buffer.
+     */
+    void append(const char *data, qint64 size);
+
+    /*!
+     * Discard all retained output.
+     */
+    void clear();
+
+    /*!
+     * Returns the amount of retained output, at most capacity() bytes
+     */
+    qint64 size() const;
+
+    /*!
+     * Decompress the retained output.
+     *
+     * Returns the most recent output, at most capacity() bytes
+     */
+    QByteArray replay() const;
+
+    /*!
+     * Returns the memory and CPU usage of the buffer
+     */
+    Statistics statistics() const;
+
+private:
+    std::unique_ptr<KPtyRetentionBufferPrivate> const d_ptr;
+};
+
+#endif
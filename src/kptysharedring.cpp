@@ -0,0 +1,421 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kptysharedring_p.h"
+
+#include <config-pty.h>
+#include <kpty_debug.h>
+
+#include <KLocalizedString>
+
+#include <QDeadlineTimer>
+#include <QSocketNotifier>
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+
+#define HAVE_SHARED_RING (HAVE_MEMFD_CREATE && HAVE_SYS_EVENTFD_H)
+
+static void signalEvent(int fd)
+{
+#if HAVE_SHARED_RING
+    eventfd_write(fd, 1);
+#else
+    Q_UNUSED(fd);
+#endif
+}
+
+static void clearEvent(int fd)
+{
+#if HAVE_SHARED_RING
+    eventfd_t value;
+    eventfd_read(fd, &value);
+#else
+    Q_UNUSED(fd);
+#endif
+}
+
+static void closeDescriptors(KPtySharedRingReader::Descriptors &descriptors)
+{
+    for (int *fd : {&descriptors.memory, &descriptors.dataEvent, &descriptors.spaceEvent}) {
+        if (*fd >= 0) {
+            ::close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+////////////////////
+// device side    //
+////////////////////
+
+KPtySharedRingWriter::~KPtySharedRingWriter()
+{
+    if (header) {
+        finish();
+        munmap(header, mapSize);
+    }
+    closeDescriptors(descriptors);
+}
+
+bool KPtySharedRingWriter::create(qint64 requested)
+{
+#if HAVE_SHARED_RING
+    capacity = 4096;
+    while (capacity < quint64(requested)) {
+        capacity <<= 1;
+    }
+    mapSize = KPTY_RING_DATA_OFFSET + capacity;
+
+    // sealed, so the reader can rely on the size
+    descriptors.memory = memfd_create("kpty-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (descriptors.memory < 0 || ftruncate(descriptors.memory, mapSize)
+        || fcntl(descriptors.memory, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)) {
+        return false;
+    }
+    void *map = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, descriptors.memory, 0);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    header = new (map) KPtySharedRingHeader;
+    header->magic = KPTY_RING_MAGIC;
+    header->version = KPTY_RING_VERSION;
+    header->capacity = capacity;
+    data = static_cast<char *>(map) + KPTY_RING_DATA_OFFSET;
+
+    descriptors.dataEvent = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    descriptors.spaceEvent = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    return descriptors.dataEvent >= 0 && descriptors.spaceEvent >= 0;
+#else
+    Q_UNUSED(requested);
+    return false;
+#endif
+}
+
+void KPtySharedRingWriter::write(const char *src, qint64 size)
+{
+    Q_ASSERT(size <= freeSpace());
+    const quint64 position = writeOffset & (capacity - 1);
+    const qint64 first = qMin<qint64>(size, capacity - position);
+    memcpy(data + position, src, first);
+    memcpy(data, src + first, size - first);
+
+    // sequentially consistent, pairing with the reader announcing to wait
+    writeOffset += size;
+    header->writeOffset.store(writeOffset);
+    if (header->readerWaiting.exchange(0)) {
+        signalEvent(descriptors.dataEvent);
+    }
+}
+
+bool KPtySharedRingWriter::waitForSpace()
+{
+    header->writerWaiting.store(1);
+    if (freeSpace() > 0) {
+        header->writerWaiting.store(0);
+        return true;
+    }
+    return false;
+}
+
+void KPtySharedRingWriter::acknowledgeSpace()
+{
+    clearEvent(descriptors.spaceEvent);
+}
+
+void KPtySharedRingWriter::finish()
+{
+    if (!header->closed.exchange(1)) {
+        signalEvent(descriptors.dataEvent);
+    }
+}
+
+//////////////////
+// private data //
+//////////////////
+
+class KPtySharedRingReaderPrivate
+{
+public:
+    quint64 available() const
+    {
+        if (!header) {
+            return 0;
+        }
+        // more than the capacity, or wrapped around, means a broken device
+        const quint64 size = header->writeOffset.load() - header->readOffset.load(std::memory_order_relaxed);
+        return size > capacity ? 0 : size;
+    }
+
+    quint64 readPosition() const
+    {
+        return header->readOffset.load(std::memory_order_relaxed) & (capacity - 1);
+    }
+
+    void consume(quint64 size);
+    // ask the device for a signal on new output
+    void arm();
+    void activated();
+
+    KPtySharedRingReader *q_ptr;
+    KPtySharedRingReader::Descriptors descriptors;
+    KPtySharedRingHeader *header = nullptr;
+    const char *data = nullptr;
+    size_t mapSize = 0;
+    // checked when opening; the header itself may be changed later
+    quint64 capacity = 0;
+    QSocketNotifier *notifier = nullptr;
+    bool emittedReadyRead = false;
+    bool emittedFinished = false;
+};
+
+void KPtySharedRingReaderPrivate::consume(quint64 size)
+{
+    // sequentially consistent, pairing with the device announcing to wait
+    header->readOffset.store(header->readOffset.load(std::memory_order_relaxed) + size);
+    if (header->writerWaiting.exchange(0)) {
+        signalEvent(descriptors.spaceEvent);
+    }
+}
+
+void KPtySharedRingReaderPrivate::arm()
+{
+    header->readerWaiting.store(1);
+}
+
+void KPtySharedRingReaderPrivate::activated()
+{
+    KPtySharedRingReader *q = q_ptr;
+
+    clearEvent(descriptors.dataEvent);
+    arm();
+    if (available() && !emittedReadyRead) {
+        emittedReadyRead = true;
+        Q_EMIT q->readyRead();
+        emittedReadyRead = false;
+    }
+    if (header && header->closed.load() && !emittedFinished) {
+        emittedFinished = true;
+        notifier->setEnabled(false);
+        Q_EMIT q->readChannelFinished();
+    }
+}
+
+/////////////////////////////
+// public member functions //
+/////////////////////////////
+
+KPtySharedRingReader::KPtySharedRingReader(QObject *parent)
+    : QIODevice(parent)
+    , d_ptr(new KPtySharedRingReaderPrivate)
+{
+    Q_D(KPtySharedRingReader);
+    d->q_ptr = this;
+}
+
+KPtySharedRingReader::~KPtySharedRingReader()
+{
+    close();
+}
+
+bool KPtySharedRingReader::open(const Descriptors &descriptors)
+{
+    Q_D(KPtySharedRingReader);
+
+    if (isOpen()) {
+        qCWarning(KPTY_LOG) << "Attempting to open an already open shared ring";
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(descriptors.memory, &st) || st.st_size <= KPTY_RING_DATA_OFFSET) {
+        setErrorString(i18n("Invalid shared ring buffer"));
+        return false;
+    }
+    void *map = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptors.memory, 0);
+    if (map == MAP_FAILED) {
+        setErrorString(i18n("Error mapping shared ring buffer"));
+        return false;
+    }
+    auto header = static_cast<KPtySharedRingHeader *>(map);
+    const quint64 capacity = header->capacity;
+    if (header->magic != KPTY_RING_MAGIC || header->version != KPTY_RING_VERSION || capacity & (capacity - 1)
+        || quint64(st.st_size) != KPTY_RING_DATA_OFFSET + capacity) {
+        munmap(map, st.st_size);
+        setErrorString(i18n("Invalid shared ring buffer"));
+        return false;
+    }
+
+    d->header = header;
+    d->data = static_cast<const char *>(map) + KPTY_RING_DATA_OFFSET;
+    d->mapSize = st.st_size;
+    d->capacity = capacity;
+    // the memory stays mapped without the memfd
+    d->descriptors.dataEvent = fcntl(descriptors.dataEvent, F_DUPFD_CLOEXEC, 0);
+    d->descriptors.spaceEvent = fcntl(descriptors.spaceEvent, F_DUPFD_CLOEXEC, 0);
+    if (d->descriptors.dataEvent < 0 || d->descriptors.spaceEvent < 0) {
+        setErrorString(i18n("Error opening shared ring buffer"));
+        close();
+        return false;
+    }
+    fcntl(d->descriptors.dataEvent, F_SETFL, O_NONBLOCK);
+
+    d->emittedFinished = false;
+    d->notifier = new QSocketNotifier(d->descriptors.dataEvent, QSocketNotifier::Read, this);
+    connect(d->notifier, &QSocketNotifier::activated, this, [d]() {
+        d->activated();
+    });
+    d->arm();
+
+    return QIODevice::open(ReadOnly | Unbuffered);
+}
+
+void KPtySharedRingReader::close()
+{
+    Q_D(KPtySharedRingReader);
+
+    if (isOpen()) {
+        QIODevice::close();
+    }
+    delete d->notifier;
+    d->notifier = nullptr;
+    if (d->header) {
+        munmap(d->header, d->mapSize);
+        d->header = nullptr;
+        d->data = nullptr;
+    }
+    closeDescriptors(d->descriptors);
+}
+
+QByteArrayView KPtySharedRingReader::readView() const
+{
+    Q_D(const KPtySharedRingReader);
+
+    if (!d->header) {
+        return QByteArrayView();
+    }
+    const quint64 position = d->readPosition();
+    return QByteArrayView(d->data + position, qMin(d->available(), d->capacity - position));
+}
+
+void KPtySharedRingReader::consume(qint64 size)
+{
+    Q_D(KPtySharedRingReader);
+
+    Q_ASSERT(size >= 0 && quint64(size) <= d->available());
+    if (size > 0) {
+        d->consume(size);
+    }
+}
+
+bool KPtySharedRingReader::isFinished() const
+{
+    Q_D(const KPtySharedRingReader);
+    return d->header && d->header->closed.load();
+}
+
+bool KPtySharedRingReader::isSequential() const
+{
+    return true;
+}
+
+bool KPtySharedRingReader::canReadLine() const
+{
+    Q_D(const KPtySharedRingReader);
+
+    if (QIODevice::canReadLine()) {
+        return true;
+    }
+    const quint64 available = d->available();
+    if (!available) {
+        return false;
+    }
+    const quint64 position = d->readPosition();
+    const quint64 first = qMin(available, d->capacity - position);
+    return memchr(d->data + position, '\n', first) || memchr(d->data, '\n', available - first);
+}
+
+bool KPtySharedRingReader::atEnd() const
+{
+    Q_D(const KPtySharedRingReader);
+    return QIODevice::atEnd() && !d->available();
+}
+
+qint64 KPtySharedRingReader::bytesAvailable() const
+{
+    Q_D(const KPtySharedRingReader);
+    return QIODevice::bytesAvailable() + d->available();
+}
+
+bool KPtySharedRingReader::waitForReadyRead(int msecs)
+{
+    Q_D(KPtySharedRingReader);
+
+    if (!d->header) {
+        return false;
+    }
+
+    const QDeadlineTimer deadline(msecs < 0 ? QDeadlineTimer(QDeadlineTimer::Forever) : QDeadlineTimer(msecs, Qt::PreciseTimer));
+    for (;;) {
+        d->arm();
+        if (d->available()) {
+            return true;
+        }
+        if (d->header->closed.load()) {
+            return false;
+        }
+        struct pollfd pfd = {d->descriptors.dataEvent, POLLIN, 0};
+        const int timeout = deadline.isForever() ? -1 : int(qMin<qint64>(deadline.remainingTime(), INT_MAX));
+        const int ret = poll(&pfd, 1, timeout);
+        if (ret < 0 && errno != EINTR) {
+            return false;
+        }
+        if (!ret && deadline.hasExpired()) {
+            return false;
+        }
+        clearEvent(d->descriptors.dataEvent);
+    }
+}
+
+// protected
+qint64 KPtySharedRingReader::readData(char *data, qint64 maxSize)
+{
+    Q_D(KPtySharedRingReader);
+
+    if (!d->header) {
+        return -1;
+    }
+
+    const qint64 size = qMin<quint64>(maxSize, d->available());
+    const quint64 position = d->readPosition();
+    const qint64 first = qMin<quint64>(size, d->capacity - position);
+    memcpy(data, d->data + position, first);
+    memcpy(data + first, d->data, size - first);
+    if (size > 0) {
+        d->consume(size);
+    }
+    return size;
+}
+
+// protected
+qint64 KPtySharedRingReader::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+#include "moc_kptysharedring.cpp"
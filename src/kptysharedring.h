@@ -0,0 +1,140 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef kptysharedring_h
+#define kptysharedring_h
+
+#include "kpty_export.h"
+
+#include <QByteArrayView>
+#include <QIODevice>
+
+#include <memory>
+
+class KPtySharedRingReaderPrivate;
+
+/*!
+ * \class KPtySharedRingReader
+ * \inmodule KPty
+ *
+ * \brief Reads the output of a KPtyDevice from a ring buffer in shared
+ * memory, possibly in another process.
+ *
+ * KPtyDevice::setSharedRingExport() makes a device copy everything it
+ * reads from the pty into a ring buffer in a memfd. The memfd and two
+ * eventfds used for signalling make up the Descriptors, which are passed
+ * to the reading process, e.g. over a Unix socket or by inheritance. There,
+ * a KPtySharedRingReader maps the ring and reads the output right from the
+ * shared memory, without further copies through sockets or pipes.
+ *
+ * Signalling is coalesced: the device only signals the reader when the
+ * reader has announced that it waits for data, which it does each time it
+ * was notified, so there is at most one wakeup per batch of output. If the
+ * ring is full, the device stops reading from the pty until the reader
+ * made room, so no output is lost.
+ *
+ * Shared ring buffers are only available on Linux.
+ *
+ * \since 6.28
+ */
+class KPTY_EXPORT KPtySharedRingReader : public QIODevice
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(KPtySharedRingReader)
+
+public:
+    /*!
+     * \class KPtySharedRingReader::Descriptors
+     * \inmodule KPty
+     *
+     * \brief The file descriptors making up a shared ring buffer.
+     */
+    struct Descriptors {
+        /*!
+         * \variable KPtySharedRingReader::Descriptors::memory
+         * The memfd holding the ring
+         */
+        int memory = -1;
+        /*!
+         * \variable KPtySharedRingReader::Descriptors::dataEvent
+         * The eventfd signalled by the device when there is new output
+         */
+        int dataEvent = -1;
+        /*!
+         * \variable KPtySharedRingReader::Descriptors::spaceEvent
+         * The eventfd signalled by the reader when it made room
+         */
+        int spaceEvent = -1;
+    };
+
+    /*!
+     * Constructor
+     */
+    explicit KPtySharedRingReader(QObject *parent = nullptr);
+
+    /*!
+     * Destructor
+     */
+    ~KPtySharedRingReader() override;
+
+    /*!
+     * Map a shared ring buffer and open the reader for reading.
+     *
+     * The descriptors are duplicated, so they remain owned by the caller.
+     *
+     * Output already in the ring can be read right away.
+     *
+     * Returns true on success
+     */
+    bool open(const Descriptors &descriptors);
+
+    /*!
+     * Unmap the ring buffer.
+     */
+    void close() override;
+
+    /*!
+     * Returns the part of the unread output which is contiguous in the
+     * ring, without copying it
+     *
+     * The view remains valid until consume() or read() is called.
+     */
+    QByteArrayView readView() const;
+
+    /*!
+     * Mark \a size bytes of the output at the start of readView() as read.
+     */
+    void consume(qint64 size);
+
+    /*!
+     * Returns true if the device stopped exporting, so no further output
+     * will arrive
+     */
+    bool isFinished() const;
+
+    /*!
+     * Returns always true
+     */
+    bool isSequential() const override;
+
+    bool canReadLine() const override;
+
+    bool atEnd() const override;
+
+    qint64 bytesAvailable() const override;
+
+    bool waitForReadyRead(int msecs = -1) override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    std::unique_ptr<KPtySharedRingReaderPrivate> const d_ptr;
+};
+
+#endif
@@ -0,0 +1,73 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef kptysharedring_p_h
+#define kptysharedring_p_h
+
+#include "kptysharedring.h"
+
+#include <atomic>
+
+// The layout of the shared memory. Both sides map it read-write; the
+// device only ever writes writeOffset, the reader only readOffset. Neither
+// side trusts what the other one wrote, as it may be buggy or hostile.
+struct KPtySharedRingHeader {
+    quint32 magic;
+    quint32 version;
+    quint64 capacity; // a power of two
+
+    // written by the device
+    alignas(64) std::atomic<quint64> writeOffset;
+    std::atomic<quint32> closed;
+    std::atomic<quint32> writerWaiting;
+
+    // written by the reader
+    alignas(64) std::atomic<quint64> readOffset;
+    std::atomic<quint32> readerWaiting;
+};
+
+static_assert(std::atomic<quint64>::is_always_lock_free && std::atomic<quint32>::is_always_lock_free,
+              "the ring is shared between processes, so it needs lock-free atomics");
+
+#define KPTY_RING_MAGIC 0x4b505259 // "KPRY"
+#define KPTY_RING_VERSION 1
+#define KPTY_RING_DATA_OFFSET 4096
+
+// The device side of a shared ring.
+class KPtySharedRingWriter
+{
+public:
+    ~KPtySharedRingWriter();
+
+    bool create(qint64 capacity);
+
+    qint64 freeSpace() const
+    {
+        // a read offset outside [writeOffset - capacity, writeOffset] wraps
+        // around to more than the capacity, which means a broken reader
+        const quint64 used = writeOffset - header->readOffset.load(std::memory_order_acquire);
+        return used > capacity ? 0 : capacity - used;
+    }
+
+    // size must not exceed freeSpace()
+    void write(const char *data, qint64 size);
+    // Returns true if there is room already, otherwise the reader signals
+    // spaceEvent once it made room.
+    bool waitForSpace();
+    void acknowledgeSpace();
+    void finish();
+
+    KPtySharedRingReader::Descriptors descriptors;
+    KPtySharedRingHeader *header = nullptr;
+    char *data = nullptr;
+    size_t mapSize = 0;
+    // private copies of what is in the header, as the reader can write there
+    quint64 capacity = 0;
+    quint64 writeOffset = 0;
+};
+
+#endif
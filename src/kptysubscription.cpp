@@ -0,0 +1,196 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kptysubscription_p.h"
+#include "kptydevice_p.h"
+
+#include <cstring>
+
+//////////////////
+// private data //
+//////////////////
+
+KPtyDevicePrivate *KPtySubscriptionPrivate::devicePrivate() const
+{
+    return device->d_func();
+}
+
+qint64 KPtySubscriptionPrivate::lag() const
+{
+    return device ? devicePrivate()->readBufferEnd - cursor : 0;
+}
+
+void KPtySubscriptionPrivate::enforceLagLimit()
+{
+    Q_Q(KPtySubscription);
+
+    if (lagPolicy != KPtySubscription::DropOldest || lagLimit <= 0) {
+        return;
+    }
+    const qint64 excess = lag() - lagLimit;
+    if (excess > 0) {
+        cursor += excess;
+        droppedBytes += excess;
+        Q_EMIT q->outputDropped(excess);
+    }
+}
+
+void KPtySubscriptionPrivate::feed()
+{
+    Q_Q(KPtySubscription);
+
+    enforceLagLimit();
+    if (!emittedReadyRead) {
+        emittedReadyRead = true;
+        Q_EMIT q->readyRead();
+        emittedReadyRead = false;
+    }
+}
+
+/////////////////////////////
+// public member functions //
+/////////////////////////////
+
+KPtySubscription::KPtySubscription(KPtyDevice *device, QObject *parent)
+    : QIODevice(parent)
+    , d_ptr(new KPtySubscriptionPrivate(this, device))
+{
+    Q_D(KPtySubscription);
+
+    KPtyDevicePrivate *dd = d->devicePrivate();
+    d->cursor = dd->readBufferEnd;
+    dd->subscriptions.append(d);
+    dd->readBuffer.setRetaining(true);
+    connect(device, &KPtyDevice::readEof, this, &QIODevice::readChannelFinished);
+
+    QIODevice::open(ReadOnly | Unbuffered);
+}
+
+KPtySubscription::~KPtySubscription()
+{
+    Q_D(KPtySubscription);
+
+    if (d->device) {
+        KPtyDevicePrivate *dd = d->devicePrivate();
+        dd->subscriptions.removeOne(d);
+        if (dd->subscriptions.isEmpty()) {
+            dd->readBuffer.setRetaining(false);
+        }
+        dd->trimFanout();
+    }
+}
+
+KPtyDevice *KPtySubscription::device() const
+{
+    Q_D(const KPtySubscription);
+    return d->device;
+}
+
+void KPtySubscription::setLagLimit(qint64 bytes, LagPolicy policy)
+{
+    Q_D(KPtySubscription);
+
+    d->lagLimit = qMax<qint64>(0, bytes);
+    d->lagPolicy = policy;
+    if (d->device) {
+        d->enforceLagLimit();
+        d->devicePrivate()->trimFanout();
+    }
+}
+
+qint64 KPtySubscription::lagLimit() const
+{
+    Q_D(const KPtySubscription);
+    return d->lagLimit;
+}
+
+KPtySubscription::LagPolicy KPtySubscription::lagPolicy() const
+{
+    Q_D(const KPtySubscription);
+    return d->lagPolicy;
+}
+
+qint64 KPtySubscription::droppedBytes() const
+{
+    Q_D(const KPtySubscription);
+    return d->droppedBytes;
+}
+
+qint64 KPtySubscription::streamPosition() const
+{
+    Q_D(const KPtySubscription);
+    return d->cursor;
+}
+
+bool KPtySubscription::isSequential() const
+{
+    return true;
+}
+
+bool KPtySubscription::canReadLine() const
+{
+    Q_D(const KPtySubscription);
+
+    if (QIODevice::canReadLine()) {
+        return true;
+    }
+    if (!d->lag()) {
+        return false;
+    }
+    KPtyDevicePrivate *dd = d->devicePrivate();
+    bool found = false;
+    dd->readBuffer.forEachRetainedChunk(int(d->cursor - dd->retainedHead()), [&found](const char *data, int size) {
+        found = memchr(data, '\n', size);
+        return !found;
+    });
+    return found;
+}
+
+bool KPtySubscription::atEnd() const
+{
+    Q_D(const KPtySubscription);
+    return QIODevice::atEnd() && !d->lag();
+}
+
+qint64 KPtySubscription::bytesAvailable() const
+{
+    Q_D(const KPtySubscription);
+    return QIODevice::bytesAvailable() + d->lag();
+}
+
+// protected
+qint64 KPtySubscription::readData(char *data, qint64 maxSize)
+{
+    Q_D(KPtySubscription);
+
+    if (!d->device) {
+        return -1;
+    }
+
+    KPtyDevicePrivate *dd = d->devicePrivate();
+    const qint64 size = qMin(maxSize, d->lag());
+    qint64 copied = 0;
+    dd->readBuffer.forEachRetainedChunk(int(d->cursor - dd->retainedHead()), [&](const char *chunk, int len) {
+        const qint64 n = qMin<qint64>(len, size - copied);
+        memcpy(data + copied, chunk, n);
+        copied += n;
+        return copied < size;
+    });
+    d->cursor += copied;
+    dd->trimFanout();
+    return copied;
+}
+
+// protected
+qint64 KPtySubscription::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+#include "moc_kptysubscription.cpp"
@@ -0,0 +1,147 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef kptysubscription_h
+#define kptysubscription_h
+
+#include "kpty_export.h"
+
+#include <QIODevice>
+
+#include <memory>
+
+class KPtyDevice;
+class KPtySubscriptionPrivate;
+
+/*!
+ * \class KPtySubscription
+ * \inmodule KPty
+ *
+ * \brief A read-only view of the output of a KPtyDevice, for additional
+ * readers.
+ *
+ * Any number of subscriptions can be attached to a device, e.g. for a
+ * recorder or for users shadowing a session. Each of them reads the output
+ * read from the pty after it was created, at its own pace, independently
+ * of the device itself and of the other subscriptions.
+ *
+ * The output is stored once, in the device's own buffer, and kept until
+ * the device and the slowest subscription have read it; the device's read
+ * position is merely one more cursor. To keep a stalled reader from holding
+ * on to an unlimited amount of output, each subscription can have a lag
+ * limit, and a policy for what happens when it is exceeded: the oldest
+ * output can be dropped for this subscription, or the device can stop
+ * reading from the pty until the subscription catches up, which eventually
+ * blocks the writing process.
+ *
+ * The device itself has no lag limit, so output it does not read is kept
+ * like without subscriptions. An owner which only reads through
+ * subscriptions can open the device write-only, so that it does not keep
+ * any output for itself.
+ *
+ * A subscription is opened for reading when it is created, and reaches
+ * its end when the device reads EOF.
+ *
+ * \since 6.28
+ */
+class KPTY_EXPORT KPtySubscription : public QIODevice
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(KPtySubscription)
+
+public:
+    /*!
+     * \value DropOldest Drop the oldest output the subscription did not
+     *        read yet
+     * \value SuspendReading Stop reading from the pty until the
+     *        subscription caught up
+     */
+    enum LagPolicy {
+        DropOldest,
+        SuspendReading,
+    };
+    Q_ENUM(LagPolicy)
+
+    /*!
+     * Constructor
+     *
+     * \a device the device whose output is read
+     *
+     * \a parent the parent object
+     */
+    explicit KPtySubscription(KPtyDevice *device, QObject *parent = nullptr);
+
+    /*!
+     * Destructor
+     */
+    ~KPtySubscription() override;
+
+    /*!
+     * Returns the device whose output is read, or nullptr if it was deleted
+     */
+    KPtyDevice *device() const;
+
+    /*!
+     * Set how much output the subscription may fall behind.
+     *
+     * \a bytes the lag limit, or 0 for no limit, which is the default
+     *
+     * \a policy what to do when the limit is exceeded
+     *
+     * With SuspendReading, the limit may be exceeded by the size of one
+     * read from the pty.
+     */
+    void setLagLimit(qint64 bytes, LagPolicy policy = DropOldest);
+
+    /*!
+     * Returns the lag limit in bytes, or 0 if there is none
+     */
+    qint64 lagLimit() const;
+
+    /*!
+     * Returns what happens when the lag limit is exceeded
+     */
+    LagPolicy lagPolicy() const;
+
+    /*!
+     * Returns the amount of output which was dropped for this subscription
+     */
+    qint64 droppedBytes() const;
+
+    /*!
+     * Returns the stream offset of the next byte to read, counted like by
+     * KPtyExpect
+     */
+    qint64 streamPosition() const;
+
+    /*!
+     * Returns always true
+     */
+    bool isSequential() const override;
+
+    bool canReadLine() const override;
+
+    bool atEnd() const override;
+
+    qint64 bytesAvailable() const override;
+
+Q_SIGNALS:
+    /*!
+     * Emitted when \a bytes bytes of output were dropped because the lag
+     * limit was exceeded.
+     */
+    void outputDropped(qint64 bytes);
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    std::unique_ptr<KPtySubscriptionPrivate> const d_ptr;
+};
+
+#endif
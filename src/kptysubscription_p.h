@@ -0,0 +1,46 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef kptysubscription_p_h
+#define kptysubscription_p_h
+
+#include "kptydevice.h"
+#include "kptysubscription.h"
+
+#include <QPointer>
+
+class KPtyDevicePrivate;
+
+class KPtySubscriptionPrivate
+{
+    Q_DECLARE_PUBLIC(KPtySubscription)
+
+public:
+    KPtySubscriptionPrivate(KPtySubscription *parent, KPtyDevice *dev)
+        : q_ptr(parent)
+        , device(dev)
+    {
+    }
+
+    KPtyDevicePrivate *devicePrivate() const;
+
+    // the amount of output not read yet
+    qint64 lag() const;
+    void enforceLagLimit();
+    // called when output was added to the device's buffer
+    void feed();
+
+    KPtySubscription *q_ptr;
+    QPointer<KPtyDevice> device;
+    qint64 cursor = 0; // stream offset of the next byte to read
+    qint64 lagLimit = 0;
+    KPtySubscription::LagPolicy lagPolicy = KPtySubscription::DropOldest;
+    qint64 droppedBytes = 0;
+    bool emittedReadyRead = false;
+};
+
+#endif
@@ -0,0 +1,223 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kptytokenizer_p.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define KPTY_HAVE_SSE2 1
+#if defined(__GNUC__)
+#include <immintrin.h>
+#define KPTY_HAVE_AVX2 1
+#endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define KPTY_HAVE_NEON 1
+#endif
+
+static inline bool isControl(uchar c)
+{
+    return c < 0x20 || c == 0x7f;
+}
+
+static int findControlScalar(const char *data, int size)
+{
+    for (int i = 0; i < size; ++i) {
+        if (isControl(uchar(data[i]))) {
+            return i;
+        }
+    }
+    return size;
+}
+
+#ifdef KPTY_HAVE_SSE2
+static int findControlSse2(const char *data, int size)
+{
+    const __m128i limit = _mm_set1_epi8(0x1f);
+    const __m128i del = _mm_set1_epi8(0x7f);
+    int i = 0;
+    for (; i + 16 <= size; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        // unsigned v <= 0x1f, or DEL
+        const __m128i control = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(v, limit), v), _mm_cmpeq_epi8(v, del));
+        if (const int mask = _mm_movemask_epi8(control)) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + findControlScalar(data + i, size - i);
+}
+#endif
+
+#ifdef KPTY_HAVE_AVX2
+__attribute__((target("avx2"))) static int findControlAvx2(const char *data, int size)
+{
+    const __m256i limit = _mm256_set1_epi8(0x1f);
+    const __m256i del = _mm256_set1_epi8(0x7f);
+    int i = 0;
+    for (; i + 32 <= size; i += 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        const __m256i control = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(v, limit), v), _mm256_cmpeq_epi8(v, del));
+        if (const unsigned mask = _mm256_movemask_epi8(control)) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + findControlSse2(data + i, size - i);
+}
+#endif
+
+#ifdef KPTY_HAVE_NEON
+static int findControlNeon(const char *data, int size)
+{
+    const uint8x16_t limit = vdupq_n_u8(0x20);
+    const uint8x16_t del = vdupq_n_u8(0x7f);
+    int i = 0;
+    for (; i + 16 <= size; i += 16) {
+        const uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(data + i));
+        const uint8x16_t control = vorrq_u8(vcltq_u8(v, limit), vceqq_u8(v, del));
+        // narrowed to four bits per byte, as there is no movemask
+        const uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(control), 4)), 0);
+        if (mask) {
+            return i + (__builtin_ctzll(mask) >> 2);
+        }
+    }
+    return i + findControlScalar(data + i, size - i);
+}
+#endif
+
+using FindControlFunction = int (*)(const char *, int);
+
+static FindControlFunction resolveFindControl()
+{
+#if defined(KPTY_HAVE_AVX2)
+    if (__builtin_cpu_supports("avx2")) {
+        return findControlAvx2;
+    }
+#endif
+#if defined(KPTY_HAVE_SSE2)
+    return findControlSse2;
+#elif defined(KPTY_HAVE_NEON)
+    return findControlNeon;
+#else
+    return findControlScalar;
+#endif
+}
+
+int kptyFindControl(const char *data, int size)
+{
+    static const FindControlFunction findControl = resolveFindControl();
+    return findControl(data, size);
+}
+
+void KPtyTokenizer::feed(const char *data, int size, qint64 offset)
+{
+    int i = 0;
+    while (i < size) {
+        if (state == Ground) {
+            const int text = kptyFindControl(data + i, size - i);
+            if (text) {
+                append(KPtyDevice::RunType::Text, offset + i, text);
+                i += text;
+                continue;
+            }
+        }
+
+        // up to the next text, or the end of the data
+        const int start = i;
+        while (i < size) {
+            if (state == Ground && !isControl(uchar(data[i]))) {
+                break;
+            }
+            if (state == String) {
+                i += kptyFindControl(data + i, size - i);
+                if (i == size) {
+                    break;
+                }
+            }
+            step(uchar(data[i++]));
+        }
+        append(KPtyDevice::RunType::Control, offset + start, i - start);
+    }
+}
+
+void KPtyTokenizer::step(uchar c)
+{
+    // CAN and SUB abort any sequence, ESC starts a new one; other C0
+    // controls are executed without leaving the sequence
+    switch (state) {
+    case Ground:
+        if (c == 0x1b) {
+            state = Escape;
+        }
+        break;
+    case Escape:
+        if (c == '[') {
+            state = Csi;
+        } else if (c == ']' || c == 'P' || c == 'X' || c == '^' || c == '_') {
+            state = String;
+        } else if (c >= 0x20 && c <= 0x2f) {
+            state = EscapeIntermediate;
+        } else if (c == 0x18 || c == 0x1a || (c >= 0x30 && c != 0x7f)) {
+            state = Ground;
+        }
+        break;
+    case EscapeIntermediate:
+        if (c == 0x1b) {
+            state = Escape;
+        } else if (c == 0x18 || c == 0x1a || (c >= 0x30 && c != 0x7f)) {
+            state = Ground;
+        }
+        break;
+    case Csi:
+        if (c == 0x1b) {
+            state = Escape;
+        } else if (c == 0x18 || c == 0x1a || (c >= 0x40 && c != 0x7f)) {
+            state = Ground;
+        }
+        break;
+    case String:
+        if (c == 0x07 || c == 0x18 || c == 0x1a) {
+            state = Ground;
+        } else if (c == 0x1b) {
+            state = StringEscape;
+        }
+        break;
+    case StringEscape:
+        if (c == '\\') {
+            state = Ground;
+        } else {
+            // the string ended without ST, and a new sequence starts
+            state = Escape;
+            step(c);
+        }
+        break;
+    }
+}
+
+void KPtyTokenizer::append(KPtyDevice::RunType type, qint64 offset, qint64 length)
+{
+    if (!runs.isEmpty()) {
+        KPtyDevice::Run &last = runs.last();
+        if (last.type == type && last.offset + last.length == offset) {
+            last.length += length;
+            return;
+        }
+    }
+    runs.append({type, offset, length});
+}
+
+void KPtyTokenizer::prune(qint64 head)
+{
+    while (!runs.isEmpty() && runs.first().offset + runs.first().length <= head) {
+        runs.removeFirst();
+    }
+}
+
+void KPtyTokenizer::reset()
+{
+    state = Ground;
+    runs.clear();
+}
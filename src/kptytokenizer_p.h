@@ -0,0 +1,48 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE e.V. <kde-ev-board@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef kptytokenizer_p_h
+#define kptytokenizer_p_h
+
+#include "kptydevice.h"
+
+// Returns the index of the first C0 control or DEL in data, or size if
+// there is none. Uses the widest vector unit the CPU supports.
+int kptyFindControl(const char *data, int size);
+
+// Splits output into alternating runs of printable text and control
+// sequences. Only the text and string payloads are scanned with
+// kptyFindControl(); the sequences themselves are short.
+class KPtyTokenizer
+{
+public:
+    // data starts at the stream offset offset
+    void feed(const char *data, int size, qint64 offset);
+    // forget the runs before the stream offset head
+    void prune(qint64 head);
+    void reset();
+
+    // in stream offsets
+    QList<KPtyDevice::Run> runs;
+
+private:
+    enum State {
+        Ground,
+        Escape,
+        EscapeIntermediate,
+        Csi,
+        String, // OSC, DCS, SOS, PM and APC
+        StringEscape,
+    };
+
+    void step(uchar c);
+    void append(KPtyDevice::RunType type, qint64 offset, qint64 length);
+
+    State state = Ground;
+};
+
+#endif